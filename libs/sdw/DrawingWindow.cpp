@@ -101,6 +101,14 @@ uint32_t DrawingWindow::getPixelColour(size_t x, size_t y) {
 	} else return pixelBuffer[(y * width) + x];
 }
 
+uint32_t* DrawingWindow::getPixelBuffer() {
+	return pixelBuffer.data();
+}
+
+float* DrawingWindow::getDepthBuffer() {
+	return depthBuffer.data();
+}
+
 void DrawingWindow::clearPixels() {
 	std::fill(depthBuffer.begin(), depthBuffer.end(), 0);
 	std::fill(pixelBuffer.begin(), pixelBuffer.end(), 0);
@@ -31,6 +31,9 @@ public:
 	void setPixelColour(size_t x, size_t y, uint32_t colour);
 	void setPixelColour(size_t x, size_t y, float depth, uint32_t colour);
 	uint32_t getPixelColour(size_t x, size_t y);
+	// The pixels and the inverse depths behind them, row by row, for drawing code that clips to the window itself.
+	uint32_t* getPixelBuffer();
+	float* getDepthBuffer();
 	void clearPixels();
 };
 
@@ -5,12 +5,10 @@ ModelTriangle::ModelTriangle() = default;
 ModelTriangle::ModelTriangle(Vertex v0, Vertex v1, Vertex v2, IMaterial * mat, glm::vec3 normal) :
 		vertices({{v0, v1, v2}}), material(mat), normal(normal) {}
 
-Colour ModelTriangle::GetColour(std::vector<ModelTriangle> model,
-	std::vector<glm::vec3> lights,
-	Camera cam,
+Colour ModelTriangle::GetColour(const SceneView& scene,
 	LightingMode lightingMode,
-	int triangleIndex, glm::vec3 point) {
-	return material->GetColour(model, lights, cam, lightingMode, triangleIndex, point);
+	const RayTriangleIntersection& intersection, RandomStream random) const {
+	return material->GetColour(scene, lightingMode, intersection, random);
 }
 
 std::ostream &operator<<(std::ostream &os, const ModelTriangle &triangle) {
@@ -13,10 +13,8 @@ struct ModelTriangle {
 
 	ModelTriangle();
 	ModelTriangle(Vertex v0, Vertex v1, Vertex v2, IMaterial* mat, glm::vec3 normal);
-	Colour GetColour(std::vector<ModelTriangle> model,
-		std::vector<glm::vec3> lights,
-		Camera cam,
+	Colour GetColour(const SceneView& scene,
 		LightingMode lightingMode,
-		int triangleIndex, glm::vec3 point);
+		const RayTriangleIntersection& intersection, RandomStream random = RandomStream()) const;
 	friend std::ostream &operator<<(std::ostream &os, const ModelTriangle &triangle);
 };
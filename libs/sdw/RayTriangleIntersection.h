@@ -2,15 +2,17 @@
 
 #include <glm/glm.hpp>
 #include <iostream>
-#include "ModelTriangle.h"
 
 struct RayTriangleIntersection {
 	glm::vec3 intersectionPoint;
 	float distance;
-	ModelTriangle intersectedTriangle;
+	// The triangle's vertices, normal and material are fetched from the scene with this when shading.
 	size_t triangleIndex;
+	// Barycentric weights of vertices 1 and 2 at the intersection point.
+	float u{};
+	float v{};
 
 	RayTriangleIntersection();
-	RayTriangleIntersection(const glm::vec3 &point, float distance, ModelTriangle triangle, size_t index);
+	RayTriangleIntersection(const glm::vec3 &point, float distance, size_t index);
 	friend std::ostream &operator<<(std::ostream &os, const RayTriangleIntersection &intersection);
 };
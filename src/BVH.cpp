@@ -0,0 +1,345 @@
+#include <BVH.h>
+#include <algorithm>
+#if TRIANGLE_LANES == 8
+#include <immintrin.h>
+#endif
+
+#define SAH_BINS 16
+
+AABB::AABB() : min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max()) {}
+
+void AABB::grow(glm::vec3 point) {
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+void AABB::grow(const AABB& box) {
+	min = glm::min(min, box.min);
+	max = glm::max(max, box.max);
+}
+
+float AABB::surfaceArea() const {
+	if (min.x > max.x) return 0;
+	glm::vec3 extent = max - min;
+	return 2.0f * ((extent.x * extent.y) + (extent.y * extent.z) + (extent.z * extent.x));
+}
+
+float AABB::intersect(glm::vec3 startPosition, glm::vec3 inverseDirection, float maxDistance) const {
+	glm::vec3 t0 = (min - startPosition) * inverseDirection;
+	glm::vec3 t1 = (max - startPosition) * inverseDirection;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+	float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+	return entry <= exit ? entry : std::numeric_limits<float>::max();
+}
+
+int AABB::intersect(const RayPacket& packet, const PacketHit& hits, int laneMask) const {
+	glm::vec3 lower = min - packet.origin;
+	glm::vec3 upper = max - packet.origin;
+	// Interval test first: bound where any ray of the packet could enter and leave the box by the
+	// range of inverse directions, and cull the box for the whole packet if the bounds cross.
+	if (packet.coherent) {
+		float entry = 0;
+		float exit = 0;
+		for (int lane = 0; lane < PACKET_SIZE; lane++) {
+			if (laneMask & (1 << lane)) exit = std::max(exit, hits.t[lane]);
+		}
+		for (int axis = 0; axis < 3; axis++) {
+			bool positive = packet.minInverseDirection[axis] > 0.0f;
+			float nearPlane = positive ? lower[axis] : upper[axis];
+			float farPlane = positive ? upper[axis] : lower[axis];
+			entry = std::max(entry, std::min(nearPlane * packet.minInverseDirection[axis], nearPlane * packet.maxInverseDirection[axis]));
+			exit = std::min(exit, std::max(farPlane * packet.minInverseDirection[axis], farPlane * packet.maxInverseDirection[axis]));
+		}
+		if (entry > exit) return 0;
+	}
+
+#if TRIANGLE_LANES == 8
+	int mask = 0;
+	for (int group = 0; group < PACKET_SIZE; group += 8) {
+		__m256 entry = _mm256_setzero_ps();
+		__m256 exit = _mm256_loadu_ps(hits.t + group);
+		for (int axis = 0; axis < 3; axis++) {
+			__m256 inverseDirection = _mm256_loadu_ps(packet.inverseDirections[axis] + group);
+			__m256 t0 = _mm256_mul_ps(_mm256_set1_ps(lower[axis]), inverseDirection);
+			__m256 t1 = _mm256_mul_ps(_mm256_set1_ps(upper[axis]), inverseDirection);
+			entry = _mm256_max_ps(_mm256_min_ps(t0, t1), entry);
+			exit = _mm256_min_ps(_mm256_max_ps(t0, t1), exit);
+		}
+		mask |= _mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ)) << group;
+	}
+	return mask & laneMask;
+#else
+	int mask = 0;
+	for (int lane = 0; lane < PACKET_SIZE; lane++) {
+		if ((laneMask & (1 << lane)) == 0) continue;
+		if (intersect(packet.origin, packet.rays[lane].inverseDirection, hits.t[lane]) != std::numeric_limits<float>::max()) mask |= 1 << lane;
+	}
+	return mask;
+#endif
+}
+
+BVH::BVH() : builtCost(0) {}
+
+// The bounds of each triangle, indexed the same as the model.
+static std::vector<AABB> getTriangleBounds(const std::vector<ModelTriangle>& model) {
+	std::vector<AABB> triangleBounds(model.size());
+	for (int i = 0; i < model.size(); i++) {
+		for (int j = 0; j < 3; j++) triangleBounds[i].grow(model[i].vertices[j].position);
+	}
+	return triangleBounds;
+}
+
+BVH::BVH(const std::vector<ModelTriangle>& model) : builtCost(0) {
+	std::vector<AABB> triangleBounds = getTriangleBounds(model);
+	std::vector<glm::vec3> centroids(model.size());
+	for (int i = 0; i < model.size(); i++) {
+		centroids[i] = (model[i].vertices[0].position + model[i].vertices[1].position + model[i].vertices[2].position) / 3.0f;
+	}
+	build(triangleBounds, centroids);
+}
+
+BVH::BVH(const std::vector<AABB>& primitiveBounds) : builtCost(0) {
+	std::vector<glm::vec3> centroids(primitiveBounds.size());
+	for (int i = 0; i < primitiveBounds.size(); i++) centroids[i] = (primitiveBounds[i].min + primitiveBounds[i].max) * 0.5f;
+	build(primitiveBounds, centroids);
+}
+
+void BVH::build(const std::vector<AABB>& triangleBounds, const std::vector<glm::vec3>& centroids) {
+	if (triangleBounds.empty()) return;
+
+	triangleIndices.resize(triangleBounds.size());
+	for (int i = 0; i < triangleBounds.size(); i++) triangleIndices[i] = i;
+
+	// A binary tree over n leaves never needs more than 2n - 1 nodes.
+	nodes.reserve(2 * triangleBounds.size());
+	BVHNode root;
+	root.leftFirst = 0;
+	root.count = triangleBounds.size();
+	nodes.push_back(root);
+	updateBounds(0, triangleBounds);
+	subdivide(0, triangleBounds, centroids, 0);
+	alignLeaves();
+	builtCost = getCost();
+#ifdef WIDE_BVH
+	wide = WideBVH(*this);
+#endif
+}
+
+bool BVH::isEmpty() const { return nodes.empty(); }
+
+bool BVH::refit(const std::vector<ModelTriangle>& model) {
+	return refit(getTriangleBounds(model));
+}
+
+// Children are always stored after their parent, so walking the nodes backwards visits both
+// children before the node that joins them.
+bool BVH::refit(const std::vector<AABB>& primitiveBounds) {
+	for (int i = nodes.size() - 1; i >= 0; i--) {
+		BVHNode& node = nodes[i];
+		node.bounds = AABB();
+		if (node.count > 0) {
+			for (int j = node.leftFirst; j < node.leftFirst + node.count; j++) node.bounds.grow(primitiveBounds[triangleIndices[j]]);
+		}
+		else {
+			node.bounds.grow(nodes[node.leftFirst].bounds);
+			node.bounds.grow(nodes[node.leftFirst + 1].bounds);
+		}
+	}
+#ifdef WIDE_BVH
+	wide = WideBVH(*this);
+#endif
+	return getCost() <= builtCost * REFIT_COST_LIMIT;
+}
+
+// The kernel tests a whole block of lanes at once, so a leaf costs the same for any count up to the block size.
+static int laneBlocks(int count) { return (count + TRIANGLE_LANES - 1) / TRIANGLE_LANES; }
+
+// Interior nodes cost one box test per ray that reaches them and leaves one kernel call per block,
+// weighted by how likely a ray that hits the root is to reach the node.
+float BVH::getCost() const {
+	if (nodes.empty()) return 0;
+	float rootArea = nodes[0].bounds.surfaceArea();
+	if (rootArea == 0) return 0;
+	float cost = 0;
+	for (int i = 0; i < nodes.size(); i++) {
+		float probability = nodes[i].bounds.surfaceArea() / rootArea;
+		cost += probability * (nodes[i].count > 0 ? laneBlocks(nodes[i].count) : 1);
+	}
+	return cost;
+}
+
+// Moves every leaf to start on a block boundary, filling the gaps with -1 so the triangle store leaves them empty.
+void BVH::alignLeaves() {
+	std::vector<int> aligned;
+	aligned.reserve(triangleIndices.size() + (nodes.size() * TRIANGLE_LANES));
+	for (int i = 0; i < nodes.size(); i++) {
+		BVHNode& node = nodes[i];
+		if (node.count == 0) continue;
+		while (aligned.size() % TRIANGLE_LANES != 0) aligned.push_back(-1);
+		int first = aligned.size();
+		for (int j = 0; j < node.count; j++) aligned.push_back(triangleIndices[node.leftFirst + j]);
+		node.leftFirst = first;
+	}
+	triangleIndices.swap(aligned);
+}
+
+void BVH::updateBounds(int nodeIndex, const std::vector<AABB>& triangleBounds) {
+	BVHNode& node = nodes[nodeIndex];
+	node.bounds = AABB();
+	for (int i = 0; i < node.count; i++) {
+		node.bounds.grow(triangleBounds[triangleIndices[node.leftFirst + i]]);
+	}
+}
+
+// Splits a node using the surface area heuristic, evaluated over a fixed number of centroid bins per axis.
+void BVH::subdivide(int nodeIndex, const std::vector<AABB>& triangleBounds, const std::vector<glm::vec3>& centroids, int depth) {
+	int first = nodes[nodeIndex].leftFirst;
+	int count = nodes[nodeIndex].count;
+	// The traversal stack holds at most one entry per level, so the depth is capped to fit it.
+	if ((count <= 1) || (depth >= BVH_STACK_SIZE - 1)) return;
+
+	AABB centroidBounds;
+	for (int i = 0; i < count; i++) centroidBounds.grow(centroids[triangleIndices[first + i]]);
+
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = std::numeric_limits<float>::max();
+	for (int axis = 0; axis < 3; axis++) {
+		float lower = centroidBounds.min[axis];
+		float upper = centroidBounds.max[axis];
+		if (lower == upper) continue;
+
+		AABB binBounds[SAH_BINS];
+		int binCounts[SAH_BINS] = {};
+		float scale = SAH_BINS / (upper - lower);
+		for (int i = 0; i < count; i++) {
+			int triangleIndex = triangleIndices[first + i];
+			int bin = std::min(SAH_BINS - 1, (int)((centroids[triangleIndex][axis] - lower) * scale));
+			binCounts[bin]++;
+			binBounds[bin].grow(triangleBounds[triangleIndex]);
+		}
+
+		// Sweep from both ends so every split plane is costed in linear time.
+		float leftAreas[SAH_BINS - 1];
+		int leftCounts[SAH_BINS - 1];
+		AABB leftBox;
+		int leftSum = 0;
+		for (int i = 0; i < SAH_BINS - 1; i++) {
+			leftSum += binCounts[i];
+			leftBox.grow(binBounds[i]);
+			leftCounts[i] = leftSum;
+			leftAreas[i] = leftBox.surfaceArea();
+		}
+		AABB rightBox;
+		int rightSum = 0;
+		for (int i = SAH_BINS - 1; i > 0; i--) {
+			rightSum += binCounts[i];
+			rightBox.grow(binBounds[i]);
+			if ((leftCounts[i - 1] == 0) || (rightSum == 0)) continue;
+			float cost = (laneBlocks(leftCounts[i - 1]) * leftAreas[i - 1]) + (laneBlocks(rightSum) * rightBox.surfaceArea());
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	float leafCost = laneBlocks(count) * nodes[nodeIndex].bounds.surfaceArea();
+	if ((bestAxis == -1) || (bestCost >= leafCost)) return;
+
+	float lower = centroidBounds.min[bestAxis];
+	float scale = SAH_BINS / (centroidBounds.max[bestAxis] - lower);
+	int* middle = std::partition(&triangleIndices[first], &triangleIndices[first] + count, [&](int triangleIndex) {
+		return std::min(SAH_BINS - 1, (int)((centroids[triangleIndex][bestAxis] - lower) * scale)) < bestSplit;
+	});
+	int leftCount = middle - &triangleIndices[first];
+
+	int leftIndex = nodes.size();
+	BVHNode left;
+	left.leftFirst = first;
+	left.count = leftCount;
+	BVHNode right;
+	right.leftFirst = first + leftCount;
+	right.count = count - leftCount;
+	nodes.push_back(left);
+	nodes.push_back(right);
+	nodes[nodeIndex].leftFirst = leftIndex;
+	nodes[nodeIndex].count = 0;
+
+	updateBounds(leftIndex, triangleBounds);
+	updateBounds(leftIndex + 1, triangleBounds);
+	subdivide(leftIndex, triangleBounds, centroids, depth + 1);
+	subdivide(leftIndex + 1, triangleBounds, centroids, depth + 1);
+}
+
+bool BVH::getClosestHit(const Ray& ray,
+	const TriangleStore& triangles,
+	int indexBlacklist,
+	TriangleHit& hit,
+	int* triangleTests) const {
+
+#ifdef WIDE_BVH
+	return wide.getClosestHit(ray, triangles, indexBlacklist, hit, triangleTests);
+#else
+	return closestHit(ray, hit, [&](int first, int count) {
+		if (triangleTests != nullptr) *triangleTests += count;
+		return triangles.intersect(ray, first, count, indexBlacklist, hit);
+	});
+#endif
+}
+
+bool BVH::isOccluded(const Ray& ray,
+	const TriangleStore& triangles,
+	int indexBlacklist,
+	float maxDistance,
+	int* triangleTests) const {
+
+#ifdef WIDE_BVH
+	return wide.isOccluded(ray, triangles, indexBlacklist, maxDistance, triangleTests);
+#else
+	return anyHit(ray, maxDistance, [&](int first, int count) {
+		if (triangleTests != nullptr) *triangleTests += count;
+		return triangles.occluded(ray, first, count, indexBlacklist, maxDistance);
+	});
+#endif
+}
+
+void BVH::getClosestHits(const RayPacket& packet, const TriangleStore& triangles, PacketHit& hits) const {
+	if (nodes.empty()) return;
+
+	int laneMask = (1 << packet.count) - 1;
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	int nodeIndex = 0;
+	while (true) {
+		const BVHNode& node = nodes[nodeIndex];
+		// Rays that found something closer than the node drop out of it, the packet only splits up by masking.
+		int activeMask = node.bounds.intersect(packet, hits, laneMask);
+		if (activeMask != 0) {
+			if (node.count > 0) {
+				triangles.intersect(packet, node.leftFirst, node.count, activeMask, hits);
+			}
+			else {
+				// The nodes don't keep their split axis, so the children are ordered along the axis their
+				// centres are furthest apart on, by which way the packet's first ray points.
+				int nearChild = node.leftFirst;
+				int farChild = node.leftFirst + 1;
+				glm::vec3 separation = (nodes[farChild].bounds.min + nodes[farChild].bounds.max) - (nodes[nearChild].bounds.min + nodes[nearChild].bounds.max);
+				glm::vec3 distance = glm::abs(separation);
+				int axis = distance.x > distance.y ? (distance.x > distance.z ? 0 : 2) : (distance.y > distance.z ? 1 : 2);
+				if (separation[axis] * packet.directions[axis][0] < 0) std::swap(nearChild, farChild);
+				stack[stackSize] = farChild;
+				stackSize++;
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		if (stackSize == 0) break;
+		stackSize--;
+		nodeIndex = stack[stackSize];
+	}
+}
\ No newline at end of file
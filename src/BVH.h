@@ -0,0 +1,182 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <glm/glm.hpp>
+#include <ModelTriangle.h>
+#include <Intersection.h>
+#include <TriangleStore.h>
+#include <WideBVH.h>
+
+#define BVH_STACK_SIZE 64
+// How far refitting may let the SAH cost grow over the freshly built tree's before refit asks for a rebuild.
+#define REFIT_COST_LIMIT 1.5f
+
+struct AABB {
+	glm::vec3 min;
+	glm::vec3 max;
+
+	AABB();
+	void grow(glm::vec3 point);
+	void grow(const AABB& box);
+	float surfaceArea() const;
+	// Returns the distance along the ray at which it enters the box, or the max float if it misses.
+	float intersect(glm::vec3 startPosition, glm::vec3 inverseDirection, float maxDistance) const;
+	// Returns a bit for each ray in laneMask that enters the box before its hit in hits.
+	int intersect(const RayPacket& packet, const PacketHit& hits, int laneMask) const;
+};
+
+// Leaves have a non-zero count and leftFirst is the slot of their first triangle, which is always
+// the start of a block of TRIANGLE_LANES slots. Interior nodes store the index of their left child in leftFirst and the right child follows it.
+struct BVHNode {
+	AABB bounds;
+	int leftFirst;
+	int count;
+};
+
+class BVH {
+public:
+	std::vector<BVHNode> nodes;
+	// The model index held in each slot, in leaf order. Build a TriangleStore in this order to trace the tree.
+	std::vector<int> triangleIndices;
+#ifdef WIDE_BVH
+	// The tree collapsed into wide nodes, which getClosestHit and isOccluded trace instead. It is
+	// collapsed again after every build and refit.
+	WideBVH wide;
+#endif
+
+	BVH();
+	BVH(const std::vector<ModelTriangle>& model);
+	// Builds over any set of boxes, triangleIndices then holds indices into primitiveBounds.
+	BVH(const std::vector<AABB>& primitiveBounds);
+	bool isEmpty() const;
+	// Moves the bounds to the triangles' new positions without changing the tree, bottom up in one
+	// pass over the nodes. The model must hold the same triangles it was built from. Returns false
+	// when the refitted tree has got too slow to trace and should be rebuilt.
+	bool refit(const std::vector<ModelTriangle>& model);
+	bool refit(const std::vector<AABB>& primitiveBounds);
+	// The expected cost of tracing a ray through the tree, by the surface area heuristic.
+	float getCost() const;
+	// Narrows hit down to the closest triangle along the ray, returns whether anything closer was found.
+	bool getClosestHit(const Ray& ray,
+		const TriangleStore& triangles,
+		int indexBlacklist,
+		TriangleHit& hit,
+		int* triangleTests = nullptr) const;
+	// Returns true as soon as any triangle is found closer than maxDistance, for shadow rays that
+	// only need to know whether something is in the way.
+	bool isOccluded(const Ray& ray,
+		const TriangleStore& triangles,
+		int indexBlacklist,
+		float maxDistance,
+		int* triangleTests = nullptr) const;
+
+	// Traces a packet of rays together, narrowing each lane of hits to its closest triangle. A node
+	// is visited while any ray of the packet still reaches it, so this pays off for coherent rays
+	// like camera rays and single rays are better for anything scattered.
+	void getClosestHits(const RayPacket& packet, const TriangleStore& triangles, PacketHit& hits) const;
+
+	// Walks the leaves the ray reaches, nearer first. testLeaf(first, count) tests the leaf's slots,
+	// narrowing hit, and returns whether it found anything closer.
+	template <typename LeafTest>
+	bool closestHit(const Ray& ray, TriangleHit& hit, LeafTest testLeaf) const;
+	// Walks the leaves the ray reaches before maxDistance until testLeaf(first, count) returns true.
+	template <typename LeafTest>
+	bool anyHit(const Ray& ray, float maxDistance, LeafTest testLeaf) const;
+
+private:
+	void updateBounds(int nodeIndex, const std::vector<AABB>& triangleBounds);
+	float builtCost;
+
+	void build(const std::vector<AABB>& triangleBounds, const std::vector<glm::vec3>& centroids);
+	void subdivide(int nodeIndex, const std::vector<AABB>& triangleBounds, const std::vector<glm::vec3>& centroids, int depth);
+	void alignLeaves();
+};
+
+template <typename LeafTest>
+bool BVH::closestHit(const Ray& ray, TriangleHit& hit, LeafTest testLeaf) const {
+	bool found = false;
+	if (nodes[0].bounds.intersect(ray.origin, ray.inverseDirection, hit.t) == std::numeric_limits<float>::max())
+		return found;
+
+	// Each entry remembers where the ray entered the node, so nodes behind a closer hit can be skipped once popped.
+	int stack[BVH_STACK_SIZE];
+	float stackDistances[BVH_STACK_SIZE];
+	int stackSize = 0;
+	int nodeIndex = 0;
+	while (true) {
+		const BVHNode& node = nodes[nodeIndex];
+		if (node.count > 0) {
+			found |= testLeaf(node.leftFirst, node.count);
+		}
+		else {
+			// Visit the nearer child first and defer the further one.
+			int nearChild = node.leftFirst;
+			int farChild = node.leftFirst + 1;
+			float nearDistance = nodes[nearChild].bounds.intersect(ray.origin, ray.inverseDirection, hit.t);
+			float farDistance = nodes[farChild].bounds.intersect(ray.origin, ray.inverseDirection, hit.t);
+			if (farDistance < nearDistance) {
+				std::swap(nearChild, farChild);
+				std::swap(nearDistance, farDistance);
+			}
+			if (nearDistance != std::numeric_limits<float>::max()) {
+				if (farDistance != std::numeric_limits<float>::max()) {
+					stack[stackSize] = farChild;
+					stackDistances[stackSize] = farDistance;
+					stackSize++;
+				}
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		nodeIndex = -1;
+		while (stackSize > 0) {
+			stackSize--;
+			if (stackDistances[stackSize] < hit.t) {
+				nodeIndex = stack[stackSize];
+				break;
+			}
+		}
+		if (nodeIndex == -1) break;
+	}
+
+	return found;
+}
+
+template <typename LeafTest>
+bool BVH::anyHit(const Ray& ray, float maxDistance, LeafTest testLeaf) const {
+	if (nodes[0].bounds.intersect(ray.origin, ray.inverseDirection, maxDistance) == std::numeric_limits<float>::max())
+		return false;
+
+	// Any blocker will do, so there is no need to order the children or track entry distances.
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	int nodeIndex = 0;
+	while (true) {
+		const BVHNode& node = nodes[nodeIndex];
+		if (node.count > 0) {
+			if (testLeaf(node.leftFirst, node.count)) return true;
+		}
+		else {
+			int left = node.leftFirst;
+			int right = node.leftFirst + 1;
+			bool hitLeft = nodes[left].bounds.intersect(ray.origin, ray.inverseDirection, maxDistance) != std::numeric_limits<float>::max();
+			bool hitRight = nodes[right].bounds.intersect(ray.origin, ray.inverseDirection, maxDistance) != std::numeric_limits<float>::max();
+			if (hitLeft && hitRight) {
+				stack[stackSize] = right;
+				stackSize++;
+			}
+			if (hitLeft || hitRight) {
+				nodeIndex = hitLeft ? left : right;
+				continue;
+			}
+		}
+
+		if (stackSize == 0) break;
+		stackSize--;
+		nodeIndex = stack[stackSize];
+	}
+
+	return false;
+}
\ No newline at end of file
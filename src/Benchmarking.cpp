@@ -0,0 +1,1407 @@
+#include <Benchmarking.h>
+#include <Raytracing.h>
+#include <Intersection.h>
+#include <TriangleStore.h>
+#include <SceneCache.h>
+#include <InstanceSet.h>
+#include <Wavefront.h>
+#include <Deferred.h>
+#include <Rasterising.h>
+#include <Utilities.h>
+#include <ThreadPool.h>
+#include <VertexLightCache.h>
+#include <IrradianceCache.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <cstdlib>
+#include <new>
+
+#define BENCHMARK_REPEATS 3
+
+#ifdef COUNT_ALLOCATIONS
+// Every heap allocation in the program is counted, so benchmarks can check what a hot path allocates.
+// Every replaceable form of new and delete is replaced, so none of them get past the count.
+std::atomic<long long> allocationCount(0);
+static const bool countingAllocations = true;
+
+static void* countedAllocate(std::size_t size) {
+	allocationCount++;
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(std::size_t size) {
+	void* memory = countedAllocate(size);
+	if (memory == nullptr) throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](std::size_t size) {
+	void* memory = countedAllocate(size);
+	if (memory == nullptr) throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+#else
+// Allocations are only counted in builds with COUNT_ALLOCATIONS, so the renderer doesn't pay for the
+// count. Without it the count stays at zero.
+long long allocationCount = 0;
+static const bool countingAllocations = false;
+#endif
+
+// Returns the average number of seconds a call to frame takes.
+double timeFrames(const std::function<void()>& frame) {
+	frame(); // Warm up caches and any lazily created threads.
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < BENCHMARK_REPEATS; i++) frame();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / BENCHMARK_REPEATS;
+}
+
+// The triangle level benchmarks work on one flat list, with any instances baked into it.
+std::vector<ModelTriangle> bakeTriangles(const SceneView& scene) {
+	std::vector<ModelTriangle> triangles;
+	triangles.reserve(scene.getTriangleCount());
+	for (int i = 0; i < scene.getTriangleCount(); i++) triangles.push_back(scene.getTriangle(i));
+	return triangles;
+}
+
+// Ray traces the same frame with 1, 2, 4 ... up to the configured number of threads.
+// PHONG is used because it is the most expensive deterministic lighting mode.
+void benchmarkThreadScaling(const SceneView& scene, DrawingWindow& window, int maxThreads) {
+
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	double singleThreadTime = 0;
+	std::cout << "threads, seconds per frame, speedup, efficiency\n";
+	for (int i = 0; i < threadCounts.size(); i++) {
+		double seconds = timeFrames([&] {
+			rayTracedRender(scene, window, PHONG, threadCounts[i]);
+		});
+		if (i == 0) singleThreadTime = seconds;
+		double speedup = singleThreadTime / seconds;
+		std::cout << threadCounts[i] << ", " << seconds << ", " << speedup << ", " << speedup / threadCounts[i] << '\n';
+	}
+}
+
+// Checks the pool with the two calls it has to handle while a batch is running: run from inside one of
+// its own tasks, and run from another thread. Every job of every batch has to run exactly once, on a
+// thread index inside the pool, and nested jobs on the index of the task that started them.
+void benchmarkThreadPool(int threadCount) {
+	ThreadPool pool(threadCount);
+	int poolThreads = pool.getThreadCount();
+	const int outerJobs = 64;
+	const int innerJobs = 16;
+	std::vector<int> nestedRuns(outerJobs * innerJobs, 0);
+	std::vector<char> nestedOnOwnThread(outerJobs * innerJobs, 0);
+	pool.run(outerJobs, [&](int outerJob, int outerThread) {
+		pool.run(innerJobs, [&](int innerJob, int innerThread) {
+			nestedRuns[(outerJob * innerJobs) + innerJob]++;
+			nestedOnOwnThread[(outerJob * innerJobs) + innerJob] = innerThread == outerThread;
+		});
+	});
+	int nestedMismatches = 0;
+	for (int i = 0; i < nestedRuns.size(); i++) {
+		if ((nestedRuns[i] != 1) || !nestedOnOwnThread[i]) nestedMismatches++;
+	}
+	std::cout << "nested batches, " << outerJobs << " of " << innerJobs << " jobs, " << nestedMismatches << " jobs run wrongly\n";
+
+	const int callers = 4;
+	const int batches = 200;
+	const int jobs = 256;
+	std::atomic<int> concurrentMismatches(0);
+	std::vector<std::thread> callerThreads;
+	for (int caller = 0; caller < callers; caller++) {
+		callerThreads.push_back(std::thread([&] {
+			std::vector<std::atomic<int>> runs(jobs);
+			for (int batch = 0; batch < batches; batch++) {
+				for (int job = 0; job < jobs; job++) runs[job] = 0;
+				pool.run(jobs, [&](int job, int threadIndex) {
+					if ((threadIndex < 0) || (threadIndex >= poolThreads)) concurrentMismatches++;
+					runs[job]++;
+				});
+				for (int job = 0; job < jobs; job++) {
+					if (runs[job] != 1) concurrentMismatches++;
+				}
+			}
+		}));
+	}
+	for (int caller = 0; caller < callers; caller++) callerThreads[caller].join();
+	std::cout << "concurrent batches, " << callers << " threads of " << batches << " batches of " << jobs << " jobs, " <<
+		concurrentMismatches << " jobs run wrongly\n";
+	std::cout << ((nestedMismatches == 0) && (concurrentMismatches == 0) ? "PASS: every job ran once\n" : "FAIL: some jobs were lost or repeated\n");
+}
+
+// Counts the heap allocations made while ray tracing a frame in each lighting mode but SPECULAR, which
+// prints as it shades. Frame setup allocates a fixed amount, so anything that allocates per ray shows
+// up as at least one per pixel.
+void benchmarkAllocations(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	LightingMode lightingModes[] = { HARD, PROXIMITY, INCIDENCE, AMBIENT, GOURAUD, PHONG };
+	const char* lightingModeNames[] = { "HARD", "PROXIMITY", "INCIDENCE", "AMBIENT", "GOURAUD", "PHONG" };
+	if (!countingAllocations) {
+		std::cout << "The allocations benchmark needs a build with COUNT_ALLOCATIONS\n";
+		return;
+	}
+	long long pixelCount = (long long)window.width * window.height;
+	bool passed = true;
+
+	std::cout << "lighting mode, allocations per frame, allocations per pixel\n";
+	for (int i = 0; i < 6; i++) {
+		long long before = allocationCount;
+		rayTracedRender(scene, window, lightingModes[i], threadCount);
+		long long allocations = allocationCount - before;
+		std::cout << lightingModeNames[i] << ", " << allocations << ", " << (double)allocations / pixelCount << '\n';
+		if (allocations >= pixelCount) passed = false;
+	}
+	std::cout << (passed ? "PASS: no per-ray allocations\n" : "FAIL: some lighting mode allocates per ray\n");
+}
+
+// The ray-triangle test the ray tracer used before the edge precomputing kernel, kept as a baseline.
+// It solves for t, u and v by inverting the 3x3 system built from the ray and the triangle's edges.
+bool matrixInverseIntersection(glm::vec3 startPosition, glm::vec3 direction, const ModelTriangle& target, TriangleHit& hit, int triangleIndex) {
+	glm::vec3 e0 = target.vertices[1].position - target.vertices[0].position;
+	glm::vec3 e1 = target.vertices[2].position - target.vertices[0].position;
+	glm::vec3 SPVector = startPosition - target.vertices[0].position;
+	glm::mat3 DEMatrix(-direction, e0, e1);
+	glm::vec3 possibleSolution = glm::inverse(DEMatrix) * SPVector;
+
+	bool boundsCheck = ((possibleSolution.y >= 0.0) && (possibleSolution.y <= 1.0)) &&
+		((possibleSolution.z >= 0.0) && (possibleSolution.z <= 1.0)) &&
+		((possibleSolution.y + possibleSolution.z) <= 1.0);
+
+	if ((possibleSolution.x > 0) && boundsCheck && (possibleSolution.x < hit.t)) {
+		hit.t = possibleSolution.x;
+		hit.u = possibleSolution.y;
+		hit.v = possibleSolution.z;
+		hit.triangleIndex = triangleIndex;
+		return true;
+	}
+	return false;
+}
+
+// Fires random camera rays at every triangle in the scene with both the old matrix inverse test
+// and the current kernel, and reports rays per second and how often they disagree on the hit.
+void benchmarkIntersection(const SceneView& scene) {
+	std::vector<ModelTriangle> triangles = bakeTriangles(scene);
+	int rayCount = 200000;
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	std::vector<glm::vec3> origins(rayCount);
+	std::vector<glm::vec3> directions(rayCount);
+	for (int i = 0; i < rayCount; i++) {
+		origins[i] = scene.cam.position;
+		glm::vec3 target = glm::vec3(distribution(generator), distribution(generator), distribution(generator));
+		directions[i] = glm::normalize(target - origins[i]);
+	}
+
+	std::vector<TriangleEdges> edges = precomputeEdges(triangles);
+	TriangleStore store = TriangleStore(triangles);
+	std::vector<TriangleHit> referenceHits(rayCount, noHit());
+	std::vector<TriangleHit> kernelHits(rayCount, noHit());
+	std::vector<TriangleHit> storeHits(rayCount, noHit());
+	double referenceSeconds = timeFrames([&] {
+		for (int i = 0; i < rayCount; i++) {
+			referenceHits[i] = noHit();
+			for (int j = 0; j < triangles.size(); j++) {
+				matrixInverseIntersection(origins[i], directions[i], triangles[j], referenceHits[i], j);
+			}
+		}
+	});
+	double kernelSeconds = timeFrames([&] {
+		for (int i = 0; i < rayCount; i++) {
+			Ray ray = makeRay(origins[i], directions[i]);
+			kernelHits[i] = noHit();
+			for (int j = 0; j < edges.size(); j++) {
+				intersectTriangle(ray, edges[j], j, kernelHits[i]);
+			}
+		}
+	});
+	double storeSeconds = timeFrames([&] {
+		for (int i = 0; i < rayCount; i++) {
+			Ray ray = makeRay(origins[i], directions[i]);
+			storeHits[i] = noHit();
+			store.intersect(ray, 0, store.size(), std::numeric_limits<int>::max(), storeHits[i]);
+		}
+	});
+
+	int mismatches = 0;
+	int storeMismatches = 0;
+	for (int i = 0; i < rayCount; i++) {
+		if (referenceHits[i].triangleIndex != kernelHits[i].triangleIndex) mismatches++;
+		if (kernelHits[i].triangleIndex != storeHits[i].triangleIndex) storeMismatches++;
+	}
+	double tests = (double)rayCount * triangles.size();
+	std::cout << "kernel, rays per second, triangle tests per second\n";
+	std::cout << "matrix inverse, " << rayCount / referenceSeconds << ", " << tests / referenceSeconds << '\n';
+#ifdef WATERTIGHT_INTERSECTION
+	std::cout << "watertight, ";
+#else
+	std::cout << "moller-trumbore, ";
+#endif
+	std::cout << rayCount / kernelSeconds << ", " << tests / kernelSeconds << '\n';
+	std::cout << TRIANGLE_LANES << " lane store, " << rayCount / storeSeconds << ", " << tests / storeSeconds << '\n';
+	std::cout << "speedup " << referenceSeconds / kernelSeconds << ", " << mismatches << " of " << rayCount << " rays hit a different triangle\n";
+	std::cout << "store speedup over one lane " << kernelSeconds / storeSeconds << ", " << storeMismatches << " of " << rayCount << " rays hit a different triangle\n";
+}
+
+// Casts the shadow rays of a frame, one to each light and ten to points around the first light like
+// AMBIENT does, first as closest hit queries and then as occlusion queries. Reports the triangle
+// tests each shadow ray costs both ways, with and without the BVH.
+void benchmarkShadowRays(const SceneView& scene, DrawingWindow& window) {
+	std::vector<ModelTriangle> triangles = bakeTriangles(scene);
+	BVH bvh = BVH(triangles);
+	TriangleStore geometry = TriangleStore(triangles, bvh.triangleIndices);
+	glm::mat3 cameraToWorld = glm::inverse(scene.cam.orientation);
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+	std::vector<glm::vec3> origins;
+	std::vector<glm::vec3> targets;
+	std::vector<int> blacklist;
+	for (int j = 0; j < window.height; j++) {
+		for (int i = 0; i < window.width; i++) {
+			glm::vec3 direction = { (i - window.width / 2) / window.scale, (window.height / 2 - j) / window.scale, -scene.cam.focalLength };
+			Ray ray = makeRay(scene.cam.position, glm::normalize(cameraToWorld * direction));
+			TriangleHit hit = noHit();
+			if (!bvh.getClosestHit(ray, geometry, std::numeric_limits<int>::max(), hit)) continue;
+			glm::vec3 point = ray.origin + (ray.direction * hit.t);
+			std::vector<glm::vec3> lightPositions(scene.lights);
+			for (int k = 0; k < 10; k++) {
+				glm::vec3 offset = glm::vec3(distribution(generator), distribution(generator), distribution(generator));
+				lightPositions.push_back(scene.lights[0] + (0.5f * glm::normalize(offset)));
+			}
+			for (int k = 0; k < lightPositions.size(); k++) {
+				origins.push_back(point);
+				targets.push_back(lightPositions[k]);
+				blacklist.push_back(hit.triangleIndex);
+			}
+		}
+	}
+
+	long long closestTests = 0;
+	long long occlusionTests = 0;
+	int closestBlocked = 0;
+	int occlusionBlocked = 0;
+	double closestSeconds = timeFrames([&] {
+		closestTests = 0;
+		closestBlocked = 0;
+		for (int i = 0; i < origins.size(); i++) {
+			float distance = glm::length(targets[i] - origins[i]);
+			Ray ray = makeRay(origins[i], (targets[i] - origins[i]) / distance);
+			TriangleHit hit = noHit();
+			int tests = 0;
+			bvh.getClosestHit(ray, geometry, blacklist[i], hit, &tests);
+			closestTests += tests;
+			if (hit.t < distance) closestBlocked++;
+		}
+	});
+	double occlusionSeconds = timeFrames([&] {
+		occlusionTests = 0;
+		occlusionBlocked = 0;
+		for (int i = 0; i < origins.size(); i++) {
+			float distance = glm::length(targets[i] - origins[i]);
+			Ray ray = makeRay(origins[i], (targets[i] - origins[i]) / distance);
+			int tests = 0;
+			if (bvh.isOccluded(ray, geometry, blacklist[i], distance, &tests)) occlusionBlocked++;
+			occlusionTests += tests;
+		}
+	});
+
+	// Without a BVH a closest hit query tests every triangle, an occlusion query stops at the first
+	// block of lanes that holds a blocker.
+	TriangleStore unsorted = TriangleStore(triangles);
+	long long bruteForceTests = 0;
+	for (int i = 0; i < origins.size(); i++) {
+		float distance = glm::length(targets[i] - origins[i]);
+		Ray ray = makeRay(origins[i], (targets[i] - origins[i]) / distance);
+		for (int slot = 0; slot < unsorted.size(); slot += TRIANGLE_LANES) {
+			bruteForceTests += TRIANGLE_LANES;
+			if (unsorted.occluded(ray, slot, TRIANGLE_LANES, blacklist[i], distance)) break;
+		}
+	}
+
+	double rayCount = origins.size();
+	std::cout << "brute force, triangle tests per shadow ray, closest hit " << unsorted.size() << ", occlusion " << bruteForceTests / rayCount << '\n';
+	std::cout << "bvh query, shadow rays per second, triangle tests per shadow ray, blocked rays\n";
+	std::cout << "closest hit, " << rayCount / closestSeconds << ", " << closestTests / rayCount << ", " << closestBlocked << '\n';
+	std::cout << "occlusion, " << rayCount / occlusionSeconds << ", " << occlusionTests / rayCount << ", " << occlusionBlocked << '\n';
+	std::cout << "bvh saved " << (closestTests - occlusionTests) / rayCount << " triangle tests per shadow ray, speedup " << closestSeconds / occlusionSeconds << '\n';
+}
+
+// Times the per frame setup of the ray tracer's acceleration structures, building them from
+// scratch every frame against keeping them in a SceneCache while only materials change.
+void benchmarkFrameSetup(const SceneView& scene) {
+	std::vector<ModelTriangle> model = bakeTriangles(scene);
+	double rebuildSeconds = timeFrames([&] {
+		BVH bvh = BVH(model);
+		TriangleStore geometry = TriangleStore(model, bvh.triangleIndices);
+	});
+
+	// The instances are baked into the model.
+	InstanceSet noInstances;
+	SceneCache sceneCache;
+	sceneCache.update(model, noInstances);
+	IMaterial* swapped = model[0].material;
+	double cachedSeconds = timeFrames([&] {
+		std::swap(model[0].material, model[1].material);
+		sceneCache.update(model, noInstances);
+	});
+	model[0].material = swapped;
+
+	std::cout << "setup, seconds per frame\n";
+	std::cout << "rebuild every frame, " << rebuildSeconds << '\n';
+	std::cout << "scene cache, " << cachedSeconds << '\n';
+	std::cout << "speedup " << rebuildSeconds / cachedSeconds << ", " << sceneCache.getBuildCount() << " build\n";
+}
+
+// Bounces the sphere around the box for a few seconds of animation, moving its vertices every
+// frame. Times keeping the acceleration structures up to date by rebuilding them every frame and
+// by letting a SceneCache refit them, and checks how much the refitted tree has degraded.
+void benchmarkRefit(const SceneView& scene) {
+	std::vector<ModelTriangle> model = bakeTriangles(scene);
+	std::vector<ModelTriangle> original(model);
+	int firstMoving = scene.triangles.size();
+	int frameCount = 120;
+	if (firstMoving == model.size()) firstMoving = model.size() / 2;
+
+	InstanceSet noInstances;
+	SceneCache sceneCache;
+	sceneCache.update(model, noInstances);
+	double rebuildSeconds = 0;
+	double cachedSeconds = 0;
+	float worstCostRatio = 1;
+	for (int frame = 0; frame < frameCount; frame++) {
+		float time = frame / 30.0f;
+		glm::vec3 offset = glm::vec3(0.4f * std::sin(time), 0.3f * std::abs(std::sin(time * 3.0f)) - 0.15f, 0.2f * std::cos(time * 0.5f));
+		for (int i = firstMoving; i < model.size(); i++) {
+			for (int j = 0; j < 3; j++) model[i].vertices[j].position = original[i].vertices[j].position + offset;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		BVH rebuilt = BVH(model);
+		TriangleStore rebuiltGeometry = TriangleStore(model, rebuilt.triangleIndices);
+		std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+		sceneCache.update(model, noInstances);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		rebuildSeconds += std::chrono::duration<double>(middle - start).count();
+		cachedSeconds += std::chrono::duration<double>(end - middle).count();
+
+		std::vector<glm::vec3> noLights;
+		SceneView cached = sceneCache.getView(model, scene.instances, noLights, scene.cam);
+		worstCostRatio = std::max(worstCostRatio, cached.bvh.getCost() / rebuilt.getCost());
+	}
+
+	std::cout << "update, milliseconds per frame\n";
+	std::cout << "rebuild every frame, " << 1000 * rebuildSeconds / frameCount << '\n';
+	std::cout << "refit with rebuild heuristic, " << 1000 * cachedSeconds / frameCount << '\n';
+	std::cout << sceneCache.getRefitCount() << " refits, " << sceneCache.getBuildCount() - 1 << " rebuilds over " << frameCount << " frames\n";
+	std::cout << "worst SAH cost against a fresh build " << worstCostRatio << ", rebuild limit " << REFIT_COST_LIMIT << '\n';
+}
+
+// Fills the box with a grid of small copies of the scene's first instanced mesh and ray traces it.
+// Reports the memory the triangles take against baking every copy into the model.
+void benchmarkInstances(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	if (scene.instances.getInstanceCount() == 0) {
+		std::cout << "The instances benchmark needs a scene with an instanced mesh\n";
+		return;
+	}
+	const std::vector<ModelTriangle>& mesh = scene.instances.getMeshTriangles(0);
+	AABB meshBounds;
+	for (int i = 0; i < mesh.size(); i++) {
+		for (int j = 0; j < 3; j++) meshBounds.grow(mesh[i].vertices[j].position);
+	}
+	AABB sceneBounds;
+	for (int i = 0; i < scene.triangles.size(); i++) {
+		for (int j = 0; j < 3; j++) sceneBounds.grow(scene.triangles[i].vertices[j].position);
+	}
+
+	int gridSize = 16;
+	glm::vec3 cellSize = (sceneBounds.max - sceneBounds.min) / (float)gridSize;
+	glm::vec3 meshExtent = meshBounds.max - meshBounds.min;
+	float scale = 0.5f * std::min(std::min(cellSize.x, cellSize.y), cellSize.z) / std::max(std::max(meshExtent.x, meshExtent.y), meshExtent.z);
+	glm::vec3 meshCenter = (meshBounds.min + meshBounds.max) * 0.5f;
+
+	InstanceSet copies;
+	int meshIndex = copies.addMesh(mesh);
+	for (int x = 0; x < gridSize; x++) {
+		for (int y = 0; y < gridSize; y++) {
+			for (int z = 0; z < gridSize; z++) {
+				glm::vec3 center = sceneBounds.min + (cellSize * glm::vec3(x + 0.5f, y + 0.5f, z + 0.5f));
+				glm::mat4 transform = glm::translate(glm::mat4(1.0f), center);
+				transform = glm::scale(transform, glm::vec3(scale));
+				copies.addInstance(meshIndex, glm::translate(transform, -meshCenter));
+			}
+		}
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	copies.buildTopLevel();
+	std::chrono::duration<double> buildSeconds = std::chrono::steady_clock::now() - start;
+
+	SceneView instancedScene = { scene.triangles, scene.geometry, scene.lights, scene.bvh, copies, scene.cam };
+	double frameSeconds = timeFrames([&] {
+		rayTracedRender(instancedScene, window, HARD, threadCount);
+	});
+
+	double bakedBytes = (double)copies.getTriangleCount() * sizeof(ModelTriangle);
+	double instancedBytes = ((double)mesh.size() * sizeof(ModelTriangle)) + ((double)copies.getInstanceCount() * sizeof(MeshInstance));
+	std::cout << copies.getInstanceCount() << " instances, " << copies.getTriangleCount() << " triangles\n";
+	std::cout << "top level build seconds, " << buildSeconds.count() << '\n';
+	std::cout << "seconds per frame, " << frameSeconds << '\n';
+	std::cout << "triangle memory baked " << bakedBytes / (1024 * 1024) << " MB, instanced " << instancedBytes / (1024 * 1024) << " MB\n";
+}
+
+// Copies of the scene's first instanced mesh baked into one model, filling a grid of cells across
+// the scene's bounds.
+std::vector<ModelTriangle> bakeMeshGrid(const SceneView& scene, int gridSize) {
+	const std::vector<ModelTriangle>& mesh = scene.instances.getMeshTriangles(0);
+	AABB meshBounds;
+	for (int i = 0; i < mesh.size(); i++) {
+		for (int j = 0; j < 3; j++) meshBounds.grow(mesh[i].vertices[j].position);
+	}
+	AABB sceneBounds;
+	for (int i = 0; i < scene.triangles.size(); i++) {
+		for (int j = 0; j < 3; j++) sceneBounds.grow(scene.triangles[i].vertices[j].position);
+	}
+
+	glm::vec3 cellSize = (sceneBounds.max - sceneBounds.min) / (float)gridSize;
+	glm::vec3 meshExtent = meshBounds.max - meshBounds.min;
+	float scale = 0.8f * std::min(std::min(cellSize.x, cellSize.y), cellSize.z) / std::max(std::max(meshExtent.x, meshExtent.y), meshExtent.z);
+	glm::vec3 meshCenter = (meshBounds.min + meshBounds.max) * 0.5f;
+	std::vector<ModelTriangle> triangles;
+	triangles.reserve(mesh.size() * gridSize * gridSize * gridSize);
+	for (int x = 0; x < gridSize; x++) {
+		for (int y = 0; y < gridSize; y++) {
+			for (int z = 0; z < gridSize; z++) {
+				glm::vec3 center = sceneBounds.min + (cellSize * glm::vec3(x + 0.5f, y + 0.5f, z + 0.5f));
+				for (int i = 0; i < mesh.size(); i++) {
+					ModelTriangle triangle = mesh[i];
+					for (int j = 0; j < 3; j++) triangle.vertices[j].position = center + ((triangle.vertices[j].position - meshCenter) * scale);
+					triangles.push_back(triangle);
+				}
+			}
+		}
+	}
+	return triangles;
+}
+
+// Compares tracing the binary BVH against the same tree collapsed into wide quantized nodes, on a
+// grid of baked sphere copies big enough that the nodes no longer fit in cache.
+void benchmarkWideBVH(const SceneView& scene, DrawingWindow& window) {
+	if (scene.instances.getInstanceCount() == 0) {
+		std::cout << "The wide BVH benchmark needs a scene with an instanced mesh\n";
+		return;
+	}
+	std::vector<ModelTriangle> triangles = bakeMeshGrid(scene, 16);
+
+	BVH bvh = BVH(triangles);
+	TriangleStore geometry = TriangleStore(triangles, bvh.triangleIndices);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	WideBVH wide = WideBVH(bvh);
+	std::chrono::duration<double> collapseSeconds = std::chrono::steady_clock::now() - start;
+
+	glm::mat3 cameraToWorld = glm::inverse(scene.cam.orientation);
+	std::vector<Ray> rays;
+	for (int j = 0; j < window.height; j++) {
+		for (int i = 0; i < window.width; i++) {
+			glm::vec3 direction = { (i - window.width / 2) / window.scale, (window.height / 2 - j) / window.scale, -scene.cam.focalLength };
+			rays.push_back(makeRay(scene.cam.position, glm::normalize(cameraToWorld * direction)));
+		}
+	}
+
+	// The binary traversal is called directly, so the comparison holds whichever one BVH::getClosestHit uses.
+	std::vector<TriangleHit> binaryHits(rays.size());
+	std::vector<TriangleHit> wideHits(rays.size());
+	double binarySeconds = timeFrames([&] {
+		for (int i = 0; i < rays.size(); i++) {
+			binaryHits[i] = noHit();
+			bvh.closestHit(rays[i], binaryHits[i], [&](int first, int count) {
+				return geometry.intersect(rays[i], first, count, std::numeric_limits<int>::max(), binaryHits[i]);
+			});
+		}
+	});
+	double wideSeconds = timeFrames([&] {
+		for (int i = 0; i < rays.size(); i++) {
+			wideHits[i] = noHit();
+			wide.getClosestHit(rays[i], geometry, std::numeric_limits<int>::max(), wideHits[i]);
+		}
+	});
+	int mismatches = 0;
+	for (int i = 0; i < rays.size(); i++) {
+		if (binaryHits[i].triangleIndex != wideHits[i].triangleIndex) mismatches++;
+	}
+
+	// Shadow rays from every hit towards the first light.
+	std::vector<Ray> shadowRays;
+	std::vector<float> shadowDistances;
+	std::vector<int> shadowBlacklist;
+	for (int i = 0; i < rays.size(); i++) {
+		if (binaryHits[i].t == std::numeric_limits<float>::max()) continue;
+		glm::vec3 point = rays[i].origin + (rays[i].direction * binaryHits[i].t);
+		float distance = glm::length(scene.lights[0] - point);
+		shadowRays.push_back(makeRay(point, (scene.lights[0] - point) / distance));
+		shadowDistances.push_back(distance);
+		shadowBlacklist.push_back(binaryHits[i].triangleIndex);
+	}
+	int binaryBlocked = 0;
+	int wideBlocked = 0;
+	double binaryShadowSeconds = timeFrames([&] {
+		binaryBlocked = 0;
+		for (int i = 0; i < shadowRays.size(); i++) {
+			bool blocked = bvh.anyHit(shadowRays[i], shadowDistances[i], [&](int first, int count) {
+				return geometry.occluded(shadowRays[i], first, count, shadowBlacklist[i], shadowDistances[i]);
+			});
+			if (blocked) binaryBlocked++;
+		}
+	});
+	double wideShadowSeconds = timeFrames([&] {
+		wideBlocked = 0;
+		for (int i = 0; i < shadowRays.size(); i++) {
+			if (wide.isOccluded(shadowRays[i], geometry, shadowBlacklist[i], shadowDistances[i])) wideBlocked++;
+		}
+	});
+
+	double triangleCount = triangles.size();
+	std::cout << triangles.size() << " triangles, " << WIDE_BVH_WIDTH << " wide nodes with " << WIDE_BVH_BITS << " bit planes, collapsed in " << collapseSeconds.count() << " seconds\n";
+	std::cout << "layout, nodes, node bytes per triangle, camera rays per second, shadow rays per second\n";
+	std::cout << "binary, " << bvh.nodes.size() << ", " << (bvh.nodes.size() * sizeof(BVHNode)) / triangleCount << ", " << rays.size() / binarySeconds << ", " << shadowRays.size() / binaryShadowSeconds << '\n';
+	std::cout << "wide, " << wide.nodes.size() << ", " << (wide.nodes.size() * sizeof(WideBVHNode)) / triangleCount << ", " << rays.size() / wideSeconds << ", " << shadowRays.size() / wideShadowSeconds << '\n';
+	std::cout << "speedup, camera rays " << binarySeconds / wideSeconds << ", shadow rays " << binaryShadowSeconds / wideShadowSeconds << '\n';
+	std::cout << "closest hits that differ " << mismatches << ", shadow rays blocked binary " << binaryBlocked << ", wide " << wideBlocked << '\n';
+}
+
+// Camera ray throughput for packets against tracing each ray on its own, over the scene and over
+// a grid of baked sphere copies. No shading, only the closest hit of every pixel's camera ray.
+void benchmarkPackets(const SceneView& scene, DrawingWindow& window) {
+	if (scene.instances.getInstanceCount() == 0) {
+		std::cout << "The packets benchmark needs a scene with an instanced mesh\n";
+		return;
+	}
+	glm::mat3 cameraToWorld = glm::inverse(scene.cam.orientation);
+	int packetWidth = 4;
+	int packetHeight = PACKET_SIZE / packetWidth;
+	// Packets go in the same order as the pixels inside them, so lane i of packet p is ray (p * PACKET_SIZE) + i.
+	std::vector<RayPacket> packets;
+	std::vector<Ray> rays;
+	for (int y = 0; y + packetHeight <= window.height; y += packetHeight) {
+		for (int x = 0; x + packetWidth <= window.width; x += packetWidth) {
+			glm::vec3 directions[PACKET_SIZE];
+			for (int lane = 0; lane < PACKET_SIZE; lane++) {
+				int i = x + (lane % packetWidth);
+				int j = y + (lane / packetWidth);
+				glm::vec3 direction = { (i - window.width / 2) / window.scale, (window.height / 2 - j) / window.scale, -scene.cam.focalLength };
+				directions[lane] = glm::normalize(cameraToWorld * direction);
+				rays.push_back(makeRay(scene.cam.position, directions[lane]));
+			}
+			packets.push_back(makeRayPacket(scene.cam.position, directions, PACKET_SIZE));
+		}
+	}
+
+	std::vector<std::string> names = { "scene", "sphere grid" };
+	std::vector<std::vector<ModelTriangle>> models = { bakeTriangles(scene), bakeMeshGrid(scene, 16) };
+	std::cout << PACKET_SIZE << " ray packets of " << packetWidth << " by " << packetHeight << " pixels\n";
+	std::cout << "scene, triangles, binary single rays per second, BVH::getClosestHit rays per second, packet rays per second, speedup over binary, hits that differ\n";
+	for (int m = 0; m < models.size(); m++) {
+		BVH bvh = BVH(models[m]);
+		TriangleStore geometry = TriangleStore(models[m], bvh.triangleIndices);
+		std::vector<TriangleHit> singleHits(rays.size());
+		std::vector<PacketHit> packetHits(packets.size());
+
+		double binarySeconds = timeFrames([&] {
+			for (int i = 0; i < rays.size(); i++) {
+				singleHits[i] = noHit();
+				bvh.closestHit(rays[i], singleHits[i], [&](int first, int count) {
+					return geometry.intersect(rays[i], first, count, std::numeric_limits<int>::max(), singleHits[i]);
+				});
+			}
+		});
+		// With WIDE_BVH this is the wide tree, otherwise the same traversal as above.
+		double singleSeconds = timeFrames([&] {
+			for (int i = 0; i < rays.size(); i++) {
+				TriangleHit hit = noHit();
+				bvh.getClosestHit(rays[i], geometry, std::numeric_limits<int>::max(), hit);
+			}
+		});
+		double packetSeconds = timeFrames([&] {
+			for (int i = 0; i < packets.size(); i++) {
+				packetHits[i] = noPacketHit();
+				bvh.getClosestHits(packets[i], geometry, packetHits[i]);
+			}
+		});
+
+		int mismatches = 0;
+		for (int i = 0; i < rays.size(); i++) {
+			if (packetHits[i / PACKET_SIZE].triangleIndex[i % PACKET_SIZE] != singleHits[i].triangleIndex) mismatches++;
+		}
+		double rayCount = rays.size();
+		std::cout << names[m] << ", " << models[m].size() << ", " << rayCount / binarySeconds << ", " << rayCount / singleSeconds << ", " << rayCount / packetSeconds << ", " << binarySeconds / packetSeconds << ", " << mismatches << '\n';
+	}
+}
+
+// The wavefront renderer against the recursive one, at a range of batch sizes, checking the
+// images match pixel for pixel.
+void benchmarkWavefront(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	std::vector<LightingMode> modes = { HARD, PHONG };
+	std::vector<std::string> modeNames = { "hard", "phong" };
+	int pixelCount = window.width * window.height;
+	std::vector<int> batchSizes = { 1280, 5120, 20480, 81920, pixelCount };
+	std::cout << "lighting, renderer, batch size, seconds per frame, rays per second, pixels that differ from recursive\n";
+	for (int m = 0; m < modes.size(); m++) {
+		double recursiveSeconds = timeFrames([&] {
+			window.clearPixels();
+			rayTracedRender(scene, window, modes[m], threadCount);
+		});
+		std::vector<uint32_t> recursiveImage(pixelCount);
+		for (int i = 0; i < pixelCount; i++) recursiveImage[i] = window.getPixelColour(i % window.width, i / window.width);
+		std::cout << modeNames[m] << ", recursive, -, " << recursiveSeconds << ", -, -\n";
+
+		for (int b = 0; b < batchSizes.size(); b++) {
+			WavefrontStats stats;
+			double seconds = timeFrames([&] {
+				window.clearPixels();
+				stats = wavefrontRender(scene, window, modes[m], threadCount, batchSizes[b]);
+			});
+			int differences = 0;
+			for (int i = 0; i < pixelCount; i++) {
+				if (window.getPixelColour(i % window.width, i / window.width) != recursiveImage[i]) differences++;
+			}
+			double rayCount = stats.cameraRays + stats.reflectionRays + stats.shadowRays;
+			std::cout << modeNames[m] << ", wavefront, " << batchSizes[b] << ", " << seconds << ", " << rayCount / seconds << ", " << differences << '\n';
+		}
+	}
+}
+
+// Checks the block rasteriser covers exactly the pixels the per pixel edge function test says it
+// should, for the scene's triangles, a grid of small meshes and random ones hanging off the screen.
+// Then times it and counts its allocations against the scanline rasteriser it replaced.
+void benchmarkRaster(const SceneView& scene, DrawingWindow& window) {
+	std::vector<std::string> names = { "scene", "mesh grid" };
+	std::vector<std::vector<CanvasTriangle>> triangleSets(2);
+	std::vector<ModelTriangle> model = bakeTriangles(scene);
+	std::vector<ModelTriangle> grid;
+	if (scene.instances.getInstanceCount() != 0) grid = bakeMeshGrid(scene, 8);
+	for (int m = 0; m < 2; m++) {
+		const std::vector<ModelTriangle>& triangles = m == 0 ? model : grid;
+		for (int i = 0; i < triangles.size(); i++) {
+			CanvasPoint v[3];
+			for (int j = 0; j < 3; j++) v[j] = getCanvasIntersectionPoint(triangles[i].vertices[j].position, window, scene.cam);
+			triangleSets[m].push_back(CanvasTriangle(v[0], v[1], v[2]));
+		}
+	}
+	std::mt19937 generator(1);
+	std::uniform_int_distribution<int> corner(-100, std::max(window.width, window.height) + 100);
+	std::uniform_int_distribution<int> offset(-12, 12);
+	std::vector<CanvasTriangle> randomTriangles;
+	for (int i = 0; i < 2000; i++) {
+		// Half are small, so plenty have every pixel in a block that edges cross.
+		CanvasPoint v0 = CanvasPoint(corner(generator), corner(generator), 1.0f);
+		CanvasPoint v1 = i % 2 == 0 ? CanvasPoint(corner(generator), corner(generator), 2.0f) : CanvasPoint(v0.x + offset(generator), v0.y + offset(generator), 2.0f);
+		CanvasPoint v2 = i % 2 == 0 ? CanvasPoint(corner(generator), corner(generator), 3.0f) : CanvasPoint(v0.x + offset(generator), v0.y + offset(generator), 3.0f);
+		randomTriangles.push_back(CanvasTriangle(v0, v1, v2));
+	}
+
+	uint32_t white = Colour(255, 255, 255).getPackedColour();
+	long long coveredPixels = 0;
+	long long mismatches = 0;
+	for (int m = 0; m < 3; m++) {
+		const std::vector<CanvasTriangle>& triangles = m < 2 ? triangleSets[m] : randomTriangles;
+		for (int i = 0; i < triangles.size(); i++) {
+			const CanvasTriangle& triangle = triangles[i];
+			int minX = std::max(std::min({ triangle[0].x, triangle[1].x, triangle[2].x }) - 1, 0);
+			int minY = std::max(std::min({ triangle[0].y, triangle[1].y, triangle[2].y }) - 1, 0);
+			int maxX = std::min(std::max({ triangle[0].x, triangle[1].x, triangle[2].x }) + 1, window.width - 1);
+			int maxY = std::min(std::max({ triangle[0].y, triangle[1].y, triangle[2].y }) + 1, window.height - 1);
+			for (int y = minY; y <= maxY; y++) {
+				for (int x = minX; x <= maxX; x++) window.setPixelColour(x, y, 0);
+			}
+			fillTriangle(triangle, Colour(255, 255, 255), window, false);
+			for (int y = minY; y <= maxY; y++) {
+				for (int x = minX; x <= maxX; x++) {
+					bool covered = triangleCoversPixel(triangle, x, y);
+					if (covered) coveredPixels++;
+					if (covered != (window.getPixelColour(x, y) == white)) mismatches++;
+				}
+			}
+		}
+	}
+	std::cout << "coverage against the per pixel reference: " << coveredPixels << " pixels covered, " << mismatches << " differ\n";
+	std::cout << (mismatches == 0 ? "PASS: identical coverage\n" : "FAIL: coverage differs from the reference\n");
+
+	std::cout << "triangles, rasteriser, triangles, seconds per frame, allocations per frame\n";
+	for (int m = 0; m < 2; m++) {
+		const std::vector<CanvasTriangle>& triangles = triangleSets[m];
+		if (triangles.empty()) continue;
+		std::vector<Colour> colours;
+		for (int i = 0; i < triangles.size(); i++) colours.push_back(Colour(i * 37 % 256, i * 91 % 256, i * 13 % 256));
+		for (int blocks = 0; blocks < 2; blocks++) {
+			long long allocations = 0;
+			double seconds = timeFrames([&] {
+				window.clearPixels();
+				long long before = allocationCount;
+				for (int i = 0; i < triangles.size(); i++) {
+					if (blocks) fillTriangle(triangles[i], colours[i], window);
+					else drawFilledTriangle(triangles[i], colours[i], window);
+				}
+				allocations = allocationCount - before;
+			});
+			std::cout << names[m] << ", " << (blocks ? "blocks" : "scanlines") << ", " << triangles.size() << ", " << seconds << ", " << (countingAllocations ? std::to_string(allocations) : "uncounted") << '\n';
+		}
+	}
+}
+
+// Rasterises about a million triangles, a grid of copies of the scene's first instanced mesh, at
+// 1080p and 4K with 1, 2, 4 ... threads. Reports the time each phase of the binned rasteriser takes,
+// and checks every thread count draws the same image as filling the triangles one by one.
+void benchmarkBinnedRaster(const SceneView& scene, DrawingWindow& window, int maxThreads) {
+	if (scene.instances.getInstanceCount() == 0) {
+		std::cout << "The binning benchmark needs a scene with an instanced mesh\n";
+		return;
+	}
+	std::vector<ModelTriangle> grid = bakeMeshGrid(scene, 21);
+	BVH noBVH;
+	TriangleStore noGeometry;
+	InstanceSet noInstances;
+	SceneView gridScene = { grid, noGeometry, scene.lights, noBVH, noInstances, scene.cam };
+
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+	std::vector<int> widths = { 1920, 3840 };
+	std::vector<int> heights = { 1080, 2160 };
+	std::cout << grid.size() << " triangles\n";
+	std::cout << "resolution, threads, setup seconds, binning seconds, rasterising seconds, seconds per frame, speedup, tiles per triangle, pixels that differ from one thread\n";
+	for (int r = 0; r < widths.size(); r++) {
+		DrawingWindow target = DrawingWindow(widths[r], heights[r], window.scale * widths[r] / window.width, false);
+		int pixelCount = target.width * target.height;
+		double unbinnedSeconds = timeFrames([&] {
+			target.clearPixels();
+			for (int i = 0; i < grid.size(); i++) {
+				CanvasPoint v[3];
+				for (int j = 0; j < 3; j++) v[j] = getCanvasIntersectionPoint(grid[i].vertices[j].position, target, scene.cam);
+				fillTriangle(CanvasTriangle(v[0], v[1], v[2]), grid[i].GetColour(gridScene, HARD, RayTriangleIntersection(grid[i].vertices[0].position, 0, i)), target);
+			}
+		});
+		std::cout << target.width << "x" << target.height << ", unbinned, -, -, -, " << unbinnedSeconds << ", -, -, -\n";
+
+		// Culling drops back faces the unbinned triangles still draw, so the threads are checked against one thread.
+		double singleThreadSeconds = 0;
+		std::vector<uint32_t> reference(pixelCount);
+		for (int t = 0; t < threadCounts.size(); t++) {
+			RasterStats stats = {};
+			RasterStats total = {};
+			double seconds = timeFrames([&] {
+				target.clearPixels();
+				stats = rasterisedRender(gridScene, target, threadCounts[t]);
+				total.setupSeconds += stats.setupSeconds;
+				total.binningSeconds += stats.binningSeconds;
+				total.rasteriseSeconds += stats.rasteriseSeconds;
+			});
+			// timeFrames runs one warm up frame before the timed ones.
+			int frames = BENCHMARK_REPEATS + 1;
+			if (t == 0) singleThreadSeconds = seconds;
+			int differences = 0;
+			for (int i = 0; i < pixelCount; i++) {
+				if (t == 0) reference[i] = target.getPixelColour(i % target.width, i / target.width);
+				if (target.getPixelColour(i % target.width, i / target.width) != reference[i]) differences++;
+			}
+			std::cout << target.width << "x" << target.height << ", " << threadCounts[t] << ", " << total.setupSeconds / frames << ", " << total.binningSeconds / frames << ", "
+				<< total.rasteriseSeconds / frames << ", " << seconds << ", " << singleThreadSeconds / seconds << ", " << (double)stats.binnedTriangles / grid.size() << ", " << differences << '\n';
+		}
+	}
+}
+
+// The fly-through at the end of the animation in main: into the box, round the sphere and out past
+// the left wall, so for much of it there is geometry behind the camera and beside it.
+std::vector<Camera> getFlyThroughPath(Camera start) {
+	const float pi = 3.14159265f;
+	std::vector<Camera> path;
+	Camera cam = start;
+	glm::vec3 sphere = glm::vec3(0.32, -0.15, 0.4);
+	glm::vec3 target = glm::vec3(0, 0, 0);
+	glm::vec3 moveStep = (glm::vec3(0, 0, 0.75) - cam.position) / 12.0f;
+	for (int x = 0; x < 11; x++) {
+		cam.position += moveStep;
+		cam.position.y = -0.004 * (x) * (x - 8) * (x - 15.43) * (std::sqrt(x) / 3);
+		target += sphere / 12.0f;
+		cam.orientation = lookAt(cam.orientation, cam.position, target);
+		path.push_back(cam);
+	}
+	glm::vec3 targetStep = (glm::vec3(-1, 0, 0) - sphere) / 24.0f;
+	for (int i = 0; i < 23; i++) {
+		cam.position = rotateAbout(cam.position, sphere, glm::vec3(0, (1.5 * pi) / 24, 0));
+		target += targetStep;
+		cam.orientation = lookAt(cam.orientation, cam.position, target);
+		path.push_back(cam);
+	}
+	glm::vec3 oldPosition = cam.position;
+	moveStep = (glm::vec3(-1, 0, 0) - cam.position) / 24.0f;
+	for (int i = 1; i < 24; i++) {
+		float x = i;
+		cam.position = oldPosition + (x * moveStep);
+		x--;
+		cam.position.y += ((-0.0034722) * ((x - 12) * (x - 12))) + 0.5;
+		cam.orientation = lookAt(cam.orientation, cam.position, target);
+		path.push_back(cam);
+	}
+	return path;
+}
+
+// Rasterises the fly-through with the clipping and culling rasterisedRender does, and again by
+// projecting and filling every triangle as it comes, the way the raster path used to.
+void benchmarkCulling(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	std::vector<Camera> path = getFlyThroughPath(scene.cam);
+	std::vector<ModelTriangle> model = bakeTriangles(scene);
+	double culledSeconds = 0;
+	double unculledSeconds = 0;
+	RasterStats total = {};
+	for (int i = 0; i < path.size(); i++) {
+		SceneView frameScene = { scene.triangles, scene.geometry, scene.lights, scene.bvh, scene.instances, path[i] };
+		culledSeconds += timeFrames([&] {
+			window.clearPixels();
+			RasterStats stats = rasterisedRender(frameScene, window, threadCount);
+			total.backFacing += stats.backFacing;
+			total.outsideFrustum += stats.outsideFrustum;
+			total.clipped += stats.clipped;
+		});
+		unculledSeconds += timeFrames([&] {
+			window.clearPixels();
+			for (int j = 0; j < model.size(); j++) {
+				CanvasPoint v[3];
+				for (int k = 0; k < 3; k++) v[k] = getCanvasIntersectionPoint(model[j].vertices[k].position, window, path[i]);
+				fillTriangle(CanvasTriangle(v[0], v[1], v[2]), model[j].GetColour(scene, HARD, RayTriangleIntersection(model[j].vertices[0].position, 0, j)), window);
+			}
+		});
+	}
+	// timeFrames draws one warm up frame before the timed ones.
+	double drawnFrames = (double)path.size() * (BENCHMARK_REPEATS + 1);
+	std::cout << path.size() << " frames, " << model.size() << " triangles\n";
+	std::cout << "triangles per frame, back facing " << total.backFacing / drawnFrames << ", off screen " << total.outsideFrustum / drawnFrames << ", clipped " << total.clipped / drawnFrames << '\n';
+	std::cout << "rasteriser, milliseconds per frame\n";
+	std::cout << "projecting every triangle, " << 1000 * unculledSeconds / path.size() << '\n';
+	std::cout << "clipped and culled, " << 1000 * culledSeconds / path.size() << '\n';
+}
+
+// Rasterises about a million triangles, a grid of copies of the scene's first instanced mesh many layers
+// deep, in the model's order and sorted front to back. Reports how much the hierarchical depth buffer
+// skipped and the overdraw left, and how many pixels the sort changed.
+void benchmarkHierarchicalZ(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	if (scene.instances.getInstanceCount() == 0) {
+		std::cout << "The hiz benchmark needs a scene with an instanced mesh\n";
+		return;
+	}
+	std::vector<ModelTriangle> grid = bakeMeshGrid(scene, 21);
+	BVH noBVH;
+	TriangleStore noGeometry;
+	InstanceSet noInstances;
+	SceneView gridScene = { grid, noGeometry, scene.lights, noBVH, noInstances, scene.cam };
+	DrawingWindow target = DrawingWindow(1920, 1080, window.scale * 1920 / window.width, false);
+	int pixelCount = target.width * target.height;
+	std::vector<uint32_t> inOrderImage(pixelCount);
+
+	std::cout << grid.size() << " triangles at " << target.width << "x" << target.height << '\n';
+	std::cout << "order, seconds per frame, rasterising seconds, triangles skipped in tiles, blocks skipped, fragments depth tested, fragments shaded, overdraw, pixels that differ\n";
+	for (int sorted = 0; sorted < 2; sorted++) {
+		RasterStats stats = {};
+		double seconds = timeFrames([&] {
+			target.clearPixels();
+			stats = rasterisedRender(gridScene, target, threadCount, sorted == 1);
+		});
+		int differences = 0;
+		for (int i = 0; i < pixelCount; i++) {
+			uint32_t colour = target.getPixelColour(i % target.width, i / target.width);
+			if (sorted == 0) inOrderImage[i] = colour;
+			else if (colour != inOrderImage[i]) differences++;
+		}
+		std::cout << (sorted ? "front to back" : "model") << ", " << seconds << ", " << stats.rasteriseSeconds << ", " << stats.hiddenTriangles << ", " << stats.hiddenBlocks << ", "
+			<< stats.depthTestedFragments << ", " << stats.shadedFragments << ", " << (double)stats.shadedFragments / stats.coveredPixels << ", " << differences << '\n';
+	}
+}
+
+// Rasterises the scene with its textures at a few resolutions. First a textured floor running away from
+// the camera is drawn on its own, with texels large enough to see, and each pixel is checked against the
+// texel the ray tracer finds through it. Texture coordinates interpolated without the divide by depth would
+// drift by many texels towards the far end.
+void benchmarkTexturedRaster(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	IMaterial* material = nullptr;
+	for (int i = 0; i < scene.getTriangleCount(); i++) {
+		if (scene.getTriangle(i).material->GetTexture() != nullptr) material = scene.getTriangle(i).material;
+	}
+	if (material == nullptr) {
+		std::cout << "The texture benchmark needs a scene with a textured triangle\n";
+		return;
+	}
+	Vertex corners[4];
+	glm::vec3 positions[4] = { glm::vec3(-0.5, -0.5, -0.6), glm::vec3(0.5, -0.5, -0.6), glm::vec3(0.5, -0.5, -8), glm::vec3(-0.5, -0.5, -8) };
+	glm::vec2 texturePoints[4] = { glm::vec2(0.4, 0.4), glm::vec2(0.48, 0.4), glm::vec2(0.48, 0.48), glm::vec2(0.4, 0.48) };
+	for (int i = 0; i < 4; i++) {
+		corners[i].position = positions[i];
+		corners[i].texturePoint = texturePoints[i];
+	}
+	std::vector<ModelTriangle> floor = { ModelTriangle(corners[0], corners[1], corners[2], material, glm::vec3(0, 1, 0)),
+		ModelTriangle(corners[0], corners[2], corners[3], material, glm::vec3(0, 1, 0)) };
+	Camera cam = scene.cam;
+	cam.position = glm::vec3(0, 0, 0);
+	cam.orientation = glm::mat3(1);
+	BVH noBVH;
+	TriangleStore floorGeometry = TriangleStore(floor);
+	InstanceSet noInstances;
+	SceneView floorScene = { floor, floorGeometry, scene.lights, noBVH, noInstances, cam };
+	window.clearPixels();
+	rasterisedRender(floorScene, window, threadCount);
+	glm::mat3 cameraToWorld = glm::inverse(cam.orientation);
+	int texturedPixels = 0;
+	int mismatches = 0;
+	for (int y = 0; y < window.height; y++) {
+		for (int x = 0; x < window.width; x++) {
+			RayTriangleIntersection hit = getClosestIntersection(cam.position, getCameraRayDirection(x, y, floorScene, cameraToWorld, window), floorScene);
+			if (hit.distance == std::numeric_limits<float>::max()) continue;
+			texturedPixels++;
+			Colour texel = getMaterial(hit, floorScene)->GetColour(floorScene, HARD, hit, RandomStream());
+			if (texel.getPackedColour() != window.getPixelColour(x, y)) mismatches++;
+		}
+	}
+	std::cout << texturedPixels << " pixels of textured floor, " << mismatches << " differ from the ray traced texel\n";
+
+	std::vector<int> widths = { window.width, 1920, 3840 };
+	std::vector<int> heights = { window.height, 1080, 2160 };
+	std::cout << "resolution, seconds per frame, frames per second, rasterising seconds\n";
+	for (int r = 0; r < widths.size(); r++) {
+		DrawingWindow target = DrawingWindow(widths[r], heights[r], window.scale * widths[r] / window.width, false);
+		RasterStats stats = {};
+		double seconds = timeFrames([&] {
+			target.clearPixels();
+			stats = rasterisedRender(scene, target, threadCount);
+		});
+		std::cout << target.width << "x" << target.height << ", " << seconds << ", " << 1 / seconds << ", " << stats.rasteriseSeconds << '\n';
+	}
+}
+
+// The deferred renderer against the ray tracer for each lighting mode but SPECULAR, which prints as
+// it shades, checking the images match pixel for pixel.
+void benchmarkDeferred(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	std::vector<LightingMode> modes = { HARD, PROXIMITY, INCIDENCE, AMBIENT, GOURAUD, PHONG };
+	std::vector<std::string> modeNames = { "hard", "proximity", "incidence", "ambient", "gouraud", "phong" };
+	int pixelCount = window.width * window.height;
+	std::cout << "lighting, ray traced seconds per frame, deferred seconds per frame, rasterising seconds, speedup, pixels resolved from the G-buffer, camera rays traced, pixels that differ\n";
+	for (int m = 0; m < modes.size(); m++) {
+		double rayTracedSeconds = timeFrames([&] {
+			window.clearPixels();
+			rayTracedRender(scene, window, modes[m], threadCount);
+		});
+		std::vector<uint32_t> rayTracedImage(pixelCount);
+		for (int i = 0; i < pixelCount; i++) rayTracedImage[i] = window.getPixelColour(i % window.width, i / window.width);
+
+		DeferredStats stats;
+		double seconds = timeFrames([&] {
+			window.clearPixels();
+			stats = deferredRender(scene, window, modes[m], threadCount);
+		});
+		int differences = 0;
+		for (int i = 0; i < pixelCount; i++) {
+			if (window.getPixelColour(i % window.width, i / window.width) != rayTracedImage[i]) differences++;
+		}
+		std::cout << modeNames[m] << ", " << rayTracedSeconds << ", " << seconds << ", " << stats.rasteriseSeconds << ", " << rayTracedSeconds / seconds << ", "
+			<< stats.resolvedPixels << ", " << stats.tracedPixels << ", " << differences << '\n';
+	}
+}
+
+// Draws about a million triangles, a grid of copies of the scene's first instanced mesh, as a wireframe
+// and as a point cloud at 1080p. Reports how many edges or points each draws a second and what a frame allocates.
+void benchmarkLines(const SceneView& scene, DrawingWindow& window) {
+	if (scene.instances.getInstanceCount() == 0) {
+		std::cout << "The lines benchmark needs a scene with an instanced mesh\n";
+		return;
+	}
+	std::vector<ModelTriangle> grid = bakeMeshGrid(scene, 21);
+	BVH noBVH;
+	TriangleStore noGeometry;
+	InstanceSet noInstances;
+	SceneView gridScene = { grid, noGeometry, scene.lights, noBVH, noInstances, scene.cam };
+	DrawingWindow target = DrawingWindow(1920, 1080, window.scale * 1920 / window.width, false);
+
+	std::cout << grid.size() << " triangles at " << target.width << "x" << target.height << '\n';
+	std::cout << "mode, seconds per frame, edges or points per second, allocations per frame\n";
+	for (int wireframe = 0; wireframe < 2; wireframe++) {
+		long long allocations = 0;
+		double seconds = timeFrames([&] {
+			target.clearPixels();
+			long long before = allocationCount;
+			if (wireframe) wireframeRender(gridScene, target);
+			else pointcloudRender(gridScene, target);
+			allocations = allocationCount - before;
+		});
+		std::cout << (wireframe ? "wireframe" : "pointcloud") << ", " << seconds << ", " << 3 * grid.size() / seconds << ", " << (countingAllocations ? std::to_string(allocations) : "uncounted") << '\n';
+	}
+}
+
+// Renders AMBIENT, whose shadow rays go to random points around the light, with each renderer on 1,
+// 2, 4 ... up to the configured number of threads, and checks every image matches the renderer's one
+// thread image byte for byte. The renderers draw the same numbers for a pixel, so they should agree with
+// each other too, up to the rounding that differs between their camera ray kernels. The next frame
+// samples different points, so plenty of its pixels should differ.
+void benchmarkRandom(const SceneView& scene, DrawingWindow& window, int maxThreads) {
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+	int pixelCount = window.width * window.height;
+	auto countDifferences = [&](const std::vector<uint32_t>& image) {
+		int differences = 0;
+		for (int i = 0; i < pixelCount; i++) {
+			if (window.getPixelColour(i % window.width, i / window.width) != image[i]) differences++;
+		}
+		return differences;
+	};
+
+	std::vector<std::string> names = { "ray traced", "wavefront", "deferred" };
+	std::vector<uint32_t> rayTracedImage(pixelCount);
+	std::vector<uint32_t> oneThreadImage(pixelCount);
+	int mismatchedImages = 0;
+	std::cout << "renderer, threads, seconds per frame, pixels that differ from one thread, pixels that differ from ray traced\n";
+	for (int r = 0; r < names.size(); r++) {
+		for (int t = 0; t < threadCounts.size(); t++) {
+			double seconds = timeFrames([&] {
+				window.clearPixels();
+				if (r == 0) rayTracedRender(scene, window, AMBIENT, threadCounts[t]);
+				else if (r == 1) wavefrontRender(scene, window, AMBIENT, threadCounts[t]);
+				else deferredRender(scene, window, AMBIENT, threadCounts[t]);
+			});
+			if ((r == 0) && (t == 0)) {
+				for (int i = 0; i < pixelCount; i++) rayTracedImage[i] = window.getPixelColour(i % window.width, i / window.width);
+			}
+			if (t == 0) {
+				for (int i = 0; i < pixelCount; i++) oneThreadImage[i] = window.getPixelColour(i % window.width, i / window.width);
+			}
+			int differences = countDifferences(oneThreadImage);
+			if (differences != 0) mismatchedImages++;
+			std::cout << names[r] << ", " << threadCounts[t] << ", " << seconds << ", " << differences << ", " << countDifferences(rayTracedImage) << '\n';
+		}
+	}
+	std::cout << (mismatchedImages == 0 ? "PASS: identical images on every thread count\n" : "FAIL: images depend on the thread count\n");
+
+	SceneView nextFrame = scene;
+	nextFrame.frame++;
+	window.clearPixels();
+	rayTracedRender(nextFrame, window, AMBIENT, maxThreads);
+	std::cout << countDifferences(rayTracedImage) << " pixels differ in the next frame\n";
+}
+
+// Works out AMBIENT's brightness, soft shadows included, at every surface the camera sees, with each sampling
+// pattern at a range of shadow ray counts. Measures the error against a reference with 1024 Sobol samples
+// from another frame's scramble, on the brightness itself so rounding to whole colours doesn't hide it.
+// Reports how many shadow rays each pattern needs to do as well as uniform samples at 8, 16 and 64.
+void benchmarkSampling(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	glm::mat3 cameraToWorld = glm::inverse(scene.cam.orientation);
+	std::vector<RayTriangleIntersection> hits;
+	std::vector<RandomStream> streams;
+	for (int y = 0; y < window.height; y++) {
+		for (int x = 0; x < window.width; x++) {
+			RayTriangleIntersection hit = getClosestIntersection(scene.cam.position, getCameraRayDirection(x, y, scene, cameraToWorld, window), scene);
+			if ((hit.distance == std::numeric_limits<float>::max()) || !getMaterial(hit, scene)->recievesShadow) continue;
+			hits.push_back(hit);
+			streams.push_back(RandomStream(scene.frame, x, y));
+		}
+	}
+	ThreadPool& pool = getThreadPool(threadCount);
+	int jobCount = (hits.size() + 1023) / 1024;
+	auto getBrightnesses = [&](const SceneView& sampledScene, std::vector<float>& brightnesses) {
+		brightnesses.resize(hits.size());
+		pool.run(jobCount, [&](int jobIndex, int threadIndex) {
+			int end = std::min((int)hits.size(), (jobIndex + 1) * 1024);
+			for (int i = jobIndex * 1024; i < end; i++) brightnesses[i] = calculateBrightness(hits[i], AMBIENT, sampledScene, streams[i]);
+		});
+	};
+
+	SceneView referenceScene = scene;
+	referenceScene.lightSampling.pattern = SOBOL_SAMPLING;
+	referenceScene.lightSampling.sampleCount = 1024;
+	std::vector<float> reference;
+	for (int i = 0; i < streams.size(); i++) streams[i] = RandomStream(scene.frame + 1000, streams[i].getX(), streams[i].getY());
+	getBrightnesses(referenceScene, reference);
+	for (int i = 0; i < streams.size(); i++) streams[i] = RandomStream(scene.frame, streams[i].getX(), streams[i].getY());
+
+	std::vector<SamplingPattern> patterns = { UNIFORM_SAMPLING, STRATIFIED_SAMPLING, SOBOL_SAMPLING, BLUE_NOISE_SAMPLING };
+	std::vector<std::string> names = { "uniform", "stratified", "sobol", "blue noise" };
+	std::vector<int> sampleCounts = { 1, 2, 4, 8, 16, 32, 64, 128 };
+	std::vector<std::vector<double>> errors(patterns.size());
+	std::cout << hits.size() << " points lit by AMBIENT\n";
+	std::cout << "pattern, shadow rays per point, seconds per frame of lighting, rms error against the reference\n";
+	for (int p = 0; p < patterns.size(); p++) {
+		for (int c = 0; c < sampleCounts.size(); c++) {
+			SceneView sampledScene = scene;
+			sampledScene.lightSampling.pattern = patterns[p];
+			sampledScene.lightSampling.sampleCount = sampleCounts[c];
+			std::vector<float> brightnesses;
+			double seconds = timeFrames([&] {
+				getBrightnesses(sampledScene, brightnesses);
+			});
+			double squaredError = 0;
+			for (int i = 0; i < hits.size(); i++) squaredError += (brightnesses[i] - reference[i]) * (brightnesses[i] - reference[i]);
+			errors[p].push_back(std::sqrt(squaredError / hits.size()));
+			std::cout << names[p] << ", " << sampleCounts[c] << ", " << seconds << ", " << errors[p].back() << '\n';
+		}
+	}
+
+	// Interpolated on a log scale between the counts either side, as error falls as a power of the count.
+	std::vector<int> uniformCounts = { 8, 16, 64 };
+	std::cout << "pattern, shadow rays per point for the error of 8, 16 and 64 uniform ones\n";
+	for (int p = 0; p < patterns.size(); p++) {
+		std::cout << names[p];
+		for (int u = 0; u < uniformCounts.size(); u++) {
+			double target = errors[0][std::find(sampleCounts.begin(), sampleCounts.end(), uniformCounts[u]) - sampleCounts.begin()];
+			double rays = -1;
+			for (int c = 0; c < sampleCounts.size(); c++) {
+				if (errors[p][c] > target) continue;
+				if (c == 0) rays = sampleCounts[0];
+				else {
+					double t = std::log(errors[p][c - 1] / target) / std::log(errors[p][c - 1] / errors[p][c]);
+					rays = sampleCounts[c - 1] * std::pow((double)sampleCounts[c] / sampleCounts[c - 1], t);
+				}
+				break;
+			}
+			if (rays < 0) std::cout << ", over " << sampleCounts.back();
+			else std::cout << ", " << rays << " (" << uniformCounts[u] / rays << "x fewer)";
+		}
+		std::cout << '\n';
+	}
+}
+
+// Lights the scene in PHONG with 10 up to 10000 lights spread through the top of the box, half of
+// them points and half small emissive triangles facing down, at powers between 0.5 and 1.5. Times
+// a frame drawing the fixed budget of shadow rays from the light tree, and one trying every light
+// where that finishes in reasonable time. Checks how far the tree's shadowing strays from trying
+// every light at one in every 64 of the lit points.
+void benchmarkLightTree(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	AABB box = scene.bvh.nodes[0].bounds;
+	glm::vec3 size = box.max - box.min;
+	glm::mat3 cameraToWorld = glm::inverse(scene.cam.orientation);
+	std::vector<RayTriangleIntersection> hits;
+	std::vector<RandomStream> streams;
+	for (int y = 0; y < window.height; y++) {
+		for (int x = 0; x < window.width; x++) {
+			if ((((y * window.width) + x) % 64) != 0) continue;
+			RayTriangleIntersection hit = getClosestIntersection(scene.cam.position, getCameraRayDirection(x, y, scene, cameraToWorld, window), scene);
+			if ((hit.distance == std::numeric_limits<float>::max()) || !getMaterial(hit, scene)->recievesShadow) continue;
+			hits.push_back(hit);
+			streams.push_back(RandomStream(scene.frame, x, y));
+		}
+	}
+	ThreadPool& pool = getThreadPool(threadCount);
+	auto getBrightnesses = [&](const SceneView& litScene, std::vector<float>& brightnesses) {
+		brightnesses.resize(hits.size());
+		pool.run(hits.size(), [&](int i, int threadIndex) {
+			brightnesses[i] = calculateBrightness(hits[i], PHONG, litScene, streams[i]);
+		});
+	};
+
+	std::cout << "light budget of " << scene.lightSampling.lightBudget << " shadow rays per vertex, " << hits.size() << " points checked\n";
+	std::cout << "lights, seconds to build the tree, seconds per frame with the tree, seconds per frame trying every light, rms error against every light\n";
+	RandomStream placement;
+	std::vector<int> lightCounts = { 10, 100, 1000, 10000 };
+	for (int c = 0; c < lightCounts.size(); c++) {
+		std::vector<Light> lights;
+		for (int i = 0; i < lightCounts[c]; i++) {
+			glm::vec3 position = box.min + (size * glm::vec3(0.1f + (0.8f * placement.get(i, 0)), 0.6f + (0.35f * placement.get(i, 1)), 0.1f + (0.8f * placement.get(i, 2))));
+			float power = 0.5f + placement.get(i, 3);
+			if (i % 2 == 0) lights.push_back(Light::point(position, power));
+			else lights.push_back(Light::triangle(position, position + glm::vec3(0.05f, 0, 0), position + glm::vec3(0, 0, 0.05f), power));
+		}
+		LightTree tree;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		tree = LightTree(lights);
+		double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		SceneView treeScene = scene;
+		treeScene.lightTree = &tree;
+		double treeSeconds = timeFrames([&] {
+			window.clearPixels();
+			rayTracedRender(treeScene, window, PHONG, threadCount);
+		});
+		SceneView everyLightScene = treeScene;
+		everyLightScene.lightSampling.lightBudget = lightCounts[c];
+		std::cout << lightCounts[c] << ", " << buildSeconds << ", " << treeSeconds << ", ";
+		if (lightCounts[c] <= 100) {
+			double everyLightSeconds = timeFrames([&] {
+				window.clearPixels();
+				rayTracedRender(everyLightScene, window, PHONG, threadCount);
+			});
+			std::cout << everyLightSeconds << ", ";
+		}
+		else std::cout << "-, ";
+
+		std::vector<float> sampled;
+		std::vector<float> reference;
+		getBrightnesses(treeScene, sampled);
+		getBrightnesses(everyLightScene, reference);
+		double squaredError = 0;
+		for (int i = 0; i < hits.size(); i++) squaredError += (sampled[i] - reference[i]) * (sampled[i] - reference[i]);
+		std::cout << std::sqrt(squaredError / hits.size()) << '\n';
+	}
+}
+
+// Renders each lighting mode but SPECULAR, which prints as it shades, with the ray traced and wavefront
+// renderers, shadowing GOURAUD and PHONG at every pixel and then once per vertex. The per pixel
+// images are the reference. Both leave no triangle out of a vertex's shadow rays, so while every
+// light gets its own ray the cache shouldn't change a pixel. Also times indexing the scene's vertices
+// and lighting them.
+void benchmarkVertexLighting(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	std::vector<LightingMode> modes = { HARD, PROXIMITY, INCIDENCE, AMBIENT, GOURAUD, PHONG };
+	std::vector<std::string> modeNames = { "hard", "proximity", "incidence", "ambient", "gouraud", "phong" };
+	int pixelCount = window.width * window.height;
+	SceneView perPixelScene = scene;
+	perPixelScene.cacheVertexLighting = false;
+
+	VertexIndex index;
+	VertexLightCache cache;
+	double indexSeconds = timeFrames([&] { index.build(scene.triangles, scene.instances); });
+	double lightSeconds = timeFrames([&] { cache.light(scene, index, threadCount); });
+	std::cout << index.getVertexCount() << " vertices among " << scene.getTriangleCount() << " triangles, indexed in " << indexSeconds
+		<< " seconds, once per change to the geometry, and lit in " << lightSeconds << " seconds a frame\n";
+
+	std::cout << "lighting, ray traced per pixel, ray traced cached, wavefront per pixel, wavefront cached, seconds per frame, pixels that differ\n";
+	for (int m = 0; m < modes.size(); m++) {
+		std::cout << modeNames[m];
+		for (int r = 0; r < 2; r++) {
+			std::vector<uint32_t> perPixelImage(pixelCount);
+			for (int c = 0; c < 2; c++) {
+				double seconds = timeFrames([&] {
+					window.clearPixels();
+					if (r == 0) rayTracedRender(c == 0 ? perPixelScene : scene, window, modes[m], threadCount);
+					else wavefrontRender(c == 0 ? perPixelScene : scene, window, modes[m], threadCount);
+				});
+				int differences = 0;
+				for (int i = 0; i < pixelCount; i++) {
+					uint32_t colour = window.getPixelColour(i % window.width, i / window.width);
+					if (c == 0) perPixelImage[i] = colour;
+					else if (colour != perPixelImage[i]) differences++;
+				}
+				std::cout << ", " << seconds;
+				if (c == 1) std::cout << " (" << differences << ")";
+			}
+		}
+		std::cout << '\n';
+	}
+}
+
+// Lights the scene in PHONG with indirect light from a cache filled for the frame, and compares it with
+// gathering the indirect light afresh at every point, the cost brute force path tracing of one
+// bounce would have. The gathering is timed at one in every 64 of the lit points and scaled up to
+// the frame. Then follows the fly through with one cache kept across the frames and with a fresh
+// one every frame, to show how few records each new view needs.
+void benchmarkIrradianceCache(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	SceneView indirectScene = scene;
+	indirectScene.indirectLighting = true;
+	double frameSeconds = timeFrames([&] {
+		window.clearPixels();
+		rayTracedRender(indirectScene, window, PHONG, threadCount);
+	});
+	IrradianceCache cache;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	cache.update(indirectScene, window, threadCount);
+	double updateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "seconds per PHONG frame with indirect light " << frameSeconds << ", of which filling the cache " << updateSeconds
+		<< ", " << cache.getRecordCount() << " records\n";
+
+	glm::mat3 cameraToWorld = glm::inverse(scene.cam.orientation);
+	std::vector<RayTriangleIntersection> hits;
+	std::vector<RandomStream> streams;
+	int litPoints = 0;
+	int uncoveredPoints = 0;
+	for (int y = 0; y < window.height; y++) {
+		for (int x = 0; x < window.width; x++) {
+			RayTriangleIntersection hit = getClosestIntersection(scene.cam.position, getCameraRayDirection(x, y, scene, cameraToWorld, window), scene);
+			if ((hit.distance == std::numeric_limits<float>::max()) || !getMaterial(hit, scene)->recievesShadow) continue;
+			glm::vec3 irradiance;
+			if (!cache.lookup(hit.intersectionPoint, scene.getNormal(hit.triangleIndex), irradiance)) uncoveredPoints++;
+			if (litPoints++ % 64 != 0) continue;
+			hits.push_back(hit);
+			streams.push_back(RandomStream(scene.frame, x, y));
+		}
+	}
+	std::vector<glm::vec3> gathered(hits.size());
+	ThreadPool& pool = getThreadPool(threadCount);
+	double gatherSeconds = timeFrames([&] {
+		pool.run(hits.size(), [&](int i, int threadIndex) {
+			gathered[i] = gatherIrradiance(hits[i], indirectScene, streams[i]).irradiance;
+		});
+	});
+	// Points no record covers take the nearest record's light, their error is reported apart.
+	double squaredErrors[2] = { 0, 0 };
+	double squaredIndirect[2] = { 0, 0 };
+	int counts[2] = { 0, 0 };
+	for (int i = 0; i < hits.size(); i++) {
+		glm::vec3 irradiance;
+		int covered = cache.estimate(hits[i].intersectionPoint, scene.getNormal(hits[i].triangleIndex), irradiance) ? 1 : 0;
+		glm::vec3 difference = irradiance - gathered[i];
+		squaredErrors[covered] += glm::dot(difference, difference) / 3;
+		squaredIndirect[covered] += glm::dot(gathered[i], gathered[i]) / 3;
+		counts[covered]++;
+	}
+	std::cout << "gathering at every one of the " << litPoints << " lit points would take " << (gatherSeconds / hits.size()) * litPoints
+		<< " seconds a frame\n";
+	std::cout << uncoveredPoints << " of the lit points are covered by no record and take the nearest record's light\n";
+	std::cout << "points checked, count, rms difference from gathering there, rms indirect light\n";
+	for (int covered = 1; covered >= 0; covered--) {
+		if (counts[covered] == 0) continue;
+		std::cout << (covered ? "covered" : "uncovered") << ", " << counts[covered] << ", " << std::sqrt(squaredErrors[covered] / counts[covered])
+			<< ", " << std::sqrt(squaredIndirect[covered] / counts[covered]) << '\n';
+	}
+
+	std::vector<Camera> path = getFlyThroughPath(scene.cam);
+	IrradianceCache shared;
+	double sharedSeconds = 0;
+	double freshSeconds = 0;
+	std::cout << "frame, records added to the shared cache, records in a fresh cache\n";
+	for (int i = 0; i < path.size(); i++) {
+		SceneView frameScene = indirectScene;
+		frameScene.cam = path[i];
+		int before = shared.getRecordCount();
+		start = std::chrono::steady_clock::now();
+		shared.update(frameScene, window, threadCount);
+		sharedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		IrradianceCache fresh;
+		start = std::chrono::steady_clock::now();
+		fresh.update(frameScene, window, threadCount);
+		freshSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << i << ", " << shared.getRecordCount() - before << ", " << fresh.getRecordCount() << '\n';
+	}
+	std::cout << "seconds per frame filling the cache, shared " << sharedSeconds / path.size() << ", fresh " << freshSeconds / path.size() << '\n';
+}
+
+void runBenchmark(std::string name, const SceneView& scene, DrawingWindow& window, RendererState state) {
+	if (name == "threads") benchmarkThreadScaling(scene, window, state.threadCount);
+	else if (name == "threadpool") benchmarkThreadPool(state.threadCount);
+	else if (name == "allocations") benchmarkAllocations(scene, window, state.threadCount);
+	else if (name == "intersection") benchmarkIntersection(scene);
+	else if (name == "shadows") benchmarkShadowRays(scene, window);
+	else if (name == "setup") benchmarkFrameSetup(scene);
+	else if (name == "instances") benchmarkInstances(scene, window, state.threadCount);
+	else if (name == "refit") benchmarkRefit(scene);
+	else if (name == "widebvh") benchmarkWideBVH(scene, window);
+	else if (name == "packets") benchmarkPackets(scene, window);
+	else if (name == "wavefront") benchmarkWavefront(scene, window, state.threadCount);
+	else if (name == "raster") benchmarkRaster(scene, window);
+	else if (name == "binning") benchmarkBinnedRaster(scene, window, state.threadCount);
+	else if (name == "culling") benchmarkCulling(scene, window, state.threadCount);
+	else if (name == "hiz") benchmarkHierarchicalZ(scene, window, state.threadCount);
+	else if (name == "texture") benchmarkTexturedRaster(scene, window, state.threadCount);
+	else if (name == "deferred") benchmarkDeferred(scene, window, state.threadCount);
+	else if (name == "lines") benchmarkLines(scene, window);
+	else if (name == "random") benchmarkRandom(scene, window, state.threadCount);
+	else if (name == "sampling") benchmarkSampling(scene, window, state.threadCount);
+	else if (name == "lights") benchmarkLightTree(scene, window, state.threadCount);
+	else if (name == "vertexlighting") benchmarkVertexLighting(scene, window, state.threadCount);
+	else if (name == "irradiance") benchmarkIrradianceCache(scene, window, state.threadCount);
+	else std::cout << "Unknown benchmark " << name << ", expected one of: threads, threadpool, allocations, intersection, shadows, setup, instances, refit, widebvh, packets, wavefront, raster, binning, culling, hiz, texture, deferred, lines, random, sampling, lights, vertexlighting, irradiance\n";
+}
\ No newline at end of file
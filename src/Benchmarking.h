@@ -0,0 +1,12 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+#include <DrawingWindow.h>
+#include <ModelTriangle.h>
+#include <Objects.h>
+#include <SceneView.h>
+
+// Runs the named benchmark against the given scene and prints its results.
+void runBenchmark(std::string name, const SceneView& scene, DrawingWindow& window, RendererState state);
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include <Deferred.h>
+#include <Raytracing.h>
+#include <Rasterising.h>
+#include <Intersection.h>
+#include <ThreadPool.h>
+#include <FrameScene.h>
+#include <algorithm>
+#include <chrono>
+
+// How many rows of pixels one thread pool job shades.
+#define DEFERRED_JOB_ROWS 8
+
+// Whether the G-buffer has the same triangle, or none, all around (x, y). The rasteriser snaps vertices
+// to whole pixels, so within a pixel of a boundary the triangle drawn may not be the one the camera ray
+// meets, and a triangle thin enough to be snapped away entirely only ever lies next to a boundary.
+static bool isInsideTriangle(const GBuffer& gBuffer, int x, int y) {
+	int index = gBuffer.triangleIndices[(y * gBuffer.width) + x];
+	for (int neighbourY = std::max(y - 1, 0); neighbourY <= std::min(y + 1, gBuffer.height - 1); neighbourY++) {
+		for (int neighbourX = std::max(x - 1, 0); neighbourX <= std::min(x + 1, gBuffer.width - 1); neighbourX++) {
+			if (gBuffer.triangleIndices[(neighbourY * gBuffer.width) + neighbourX] != index) return false;
+		}
+	}
+	return true;
+}
+
+// Intersects the ray with the one triangle, as the ray tracer's kernel would. Only instances' triangles
+// are copied, to move them into world space.
+static bool intersectOneTriangle(const Ray& ray, int index, const SceneView& scene, TriangleHit& hit) {
+	ModelTriangle instanceTriangle;
+	if (index >= scene.triangles.size()) instanceTriangle = scene.getTriangle(index);
+	const ModelTriangle& triangle = index < scene.triangles.size() ? scene.triangles[index] : instanceTriangle;
+	TriangleEdges edges;
+	edges.v0 = triangle.vertices[0].position;
+	edges.e0 = triangle.vertices[1].position - triangle.vertices[0].position;
+	edges.e1 = triangle.vertices[2].position - triangle.vertices[0].position;
+	hit = noHit();
+	return intersectTriangle(ray, edges, index, hit);
+}
+
+DeferredStats deferredRender(const SceneView& worldScene,
+	DrawingWindow& window,
+	LightingMode lightingMode,
+	int threadCount) {
+
+	// The reflection and shadow rays need a BVH just as rayTracedRender's do.
+	FrameScene frameScene(worldScene, window, lightingMode, threadCount);
+	const SceneView& scene = frameScene.getView();
+	Camera cam = scene.cam;
+
+	DeferredStats stats = {};
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	GBuffer gBuffer;
+	rasteriseGBuffer(scene, window, gBuffer, threadCount);
+	stats.rasteriseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	glm::mat3 cameraToWorld = glm::inverse(cam.orientation);
+	ThreadPool& pool = getThreadPool(threadCount);
+	int jobCount = (window.height + DEFERRED_JOB_ROWS - 1) / DEFERRED_JOB_ROWS;
+	std::vector<DeferredStats> jobStats(jobCount, DeferredStats());
+	pool.run(jobCount, [&](int jobIndex, int threadIndex) {
+		int end = std::min(window.height, (jobIndex + 1) * DEFERRED_JOB_ROWS);
+		for (int y = jobIndex * DEFERRED_JOB_ROWS; y < end; y++) {
+			for (int x = 0; x < window.width; x++) {
+				glm::vec3 direction = getCameraRayDirection(x, y, scene, cameraToWorld, window);
+				int index = gBuffer.triangleIndices[(y * window.width) + x];
+				bool inside = isInsideTriangle(gBuffer, x, y);
+				TriangleHit hit;
+				RayTriangleIntersection intersection = noIntersection();
+				if (inside && (index == -1)) {}
+				else if (inside && intersectOneTriangle(makeRay(cam.position, direction), index, scene, hit)) {
+					intersection = makeIntersection(cam.position, direction, hit, scene);
+					jobStats[jobIndex].resolvedPixels++;
+				}
+				else {
+					intersection = getClosestIntersection(cam.position, direction, scene);
+					jobStats[jobIndex].tracedPixels++;
+				}
+				window.setPixelColour(x, y, shadePixel(intersection, scene, lightingMode, RandomStream(scene.frame, x, y)));
+			}
+		}
+	});
+	for (int job = 0; job < jobCount; job++) {
+		stats.resolvedPixels += jobStats[job].resolvedPixels;
+		stats.tracedPixels += jobStats[job].tracedPixels;
+	}
+	stats.shadeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
\ No newline at end of file
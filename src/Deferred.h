@@ -0,0 +1,26 @@
+#pragma once
+
+#include <DrawingWindow.h>
+#include <Objects.h>
+#include <SceneView.h>
+
+// How long the last deferred frame spent rasterising and shading, and how each pixel found its hit.
+// Resolved pixels took it from the G-buffer's triangle alone. Traced pixels lie on a boundary between
+// triangles, or their ray missed the G-buffer's triangle, so their camera ray was traced after all.
+// Pixels with no triangle near them are neither.
+struct DeferredStats {
+	double rasteriseSeconds;
+	double shadeSeconds;
+	long long resolvedPixels;
+	long long tracedPixels;
+};
+
+// Renders the same image as rayTracedRender while tracing almost none of the camera rays through the
+// scene. The triangle seen at each pixel is rasterised into a G-buffer, and away from the boundaries
+// between triangles the camera ray is only intersected with that one triangle, which gives the same hit
+// point and barycentric coordinates the ray tracer finds. Shading is rayTracedRender's, so only the
+// reflection and shadow rays the lighting mode asks for are traced.
+DeferredStats deferredRender(const SceneView& scene,
+	DrawingWindow& window,
+	LightingMode lightingMode,
+	int threadCount = 1);
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include <FrameScene.h>
+
+// A copy of the caller's view on the given BVH and triangle store.
+static SceneView withStructures(const SceneView& worldScene, const BVH& bvh, const TriangleStore& geometry) {
+	SceneView scene = { worldScene.triangles, geometry, worldScene.lights, bvh, worldScene.instances, worldScene.cam, worldScene.frame,
+		worldScene.lightSampling, worldScene.lightTree, worldScene.cacheVertexLighting, worldScene.vertexIndex, worldScene.vertexLighting,
+		worldScene.indirectLighting, worldScene.irradianceCache };
+	return scene;
+}
+
+// The frame's own structures are already constructed when scene is, so it can refer to them before
+// they are filled in.
+FrameScene::FrameScene(const SceneView& worldScene, DrawingWindow& window, LightingMode lightingMode, int threadCount) :
+	scene(withStructures(worldScene, worldScene.bvh.isEmpty() ? frameBVH : worldScene.bvh,
+		worldScene.bvh.isEmpty() ? frameGeometry : worldScene.geometry)) {
+
+	// Use the caller's BVH when it has one, otherwise build one for this frame.
+	if (worldScene.bvh.isEmpty()) {
+		frameBVH = BVH(worldScene.triangles);
+		frameGeometry = TriangleStore(worldScene.triangles, frameBVH.triangleIndices);
+	}
+	// Likewise for the light tree, built over the point lights.
+	if (!scene.lightTree) {
+		frameLightTree = LightTree(scene.lights);
+		scene.lightTree = &frameLightTree;
+	}
+	// Only the shadowing is redone every frame when the caller keeps the vertex index.
+	if (!scene.vertexLighting && scene.cacheVertexLighting && shadesVertices(lightingMode)) {
+		if (!scene.vertexIndex || (scene.vertexIndex->getTriangleCount() != scene.getTriangleCount())) {
+			frameVertexIndex.build(scene.triangles, scene.instances);
+			scene.vertexIndex = &frameVertexIndex;
+		}
+		frameVertexLighting.light(scene, *scene.vertexIndex, threadCount);
+		scene.vertexLighting = &frameVertexLighting;
+	}
+	// The indirect light is gathered for this frame's view when the caller keeps no irradiance cache.
+	if (scene.indirectLighting && !scene.irradianceCache && shadesIndirect(lightingMode)) {
+		frameIrradiance.update(scene, window, threadCount);
+		scene.irradianceCache = &frameIrradiance;
+	}
+}
+
+const SceneView& FrameScene::getView() const { return scene; }
\ No newline at end of file
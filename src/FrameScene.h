@@ -0,0 +1,31 @@
+#pragma once
+
+#include <DrawingWindow.h>
+#include <Objects.h>
+#include <BVH.h>
+#include <TriangleStore.h>
+#include <LightTree.h>
+#include <SceneView.h>
+#include <VertexLightCache.h>
+#include <IrradianceCache.h>
+
+// The view a renderer shades a frame with. Anything the caller's view doesn't bring along, the BVH,
+// the light tree, the vertex index and shadowing or the indirect light, is built here for this
+// frame only, and the view refers to the caller's structures where it has them and to these
+// otherwise. The view refers into the FrameScene, so it can't be used once the FrameScene is gone.
+class FrameScene {
+public:
+	FrameScene(const SceneView& worldScene, DrawingWindow& window, LightingMode lightingMode, int threadCount);
+	FrameScene(const FrameScene&) = delete;
+	FrameScene& operator=(const FrameScene&) = delete;
+	const SceneView& getView() const;
+
+private:
+	BVH frameBVH;
+	TriangleStore frameGeometry;
+	LightTree frameLightTree;
+	VertexIndex frameVertexIndex;
+	VertexLightCache frameVertexLighting;
+	IrradianceCache frameIrradiance;
+	SceneView scene;
+};
\ No newline at end of file
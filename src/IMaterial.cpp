@@ -1,10 +1,17 @@
 #include <IMaterial.h>
 #include <ModelTriangle.h>
+#include <SceneView.h>
 
 IMaterial::IMaterial() {}
 IMaterial::~IMaterial() {}
-Colour IMaterial::GetColour(std::vector<ModelTriangle> model,
-	std::vector<glm::vec3> lights,
-	Camera cam,
+Colour IMaterial::GetColour(const SceneView& scene,
 	LightingMode lightingMode,
-	int triangleIndex, glm::vec3 point) { return Colour(0,0,0); }
\ No newline at end of file
+	const RayTriangleIntersection& intersection, RandomStream random) { return Colour(0,0,0); }
+bool IMaterial::GetReflection(const SceneView& scene, int triangleIndex, glm::vec3 point, glm::vec3& direction) { return false; }
+Colour IMaterial::ShadeReflection(Colour reflected, glm::vec3 brightness) {
+	reflected.red *= brightness.r;
+	reflected.green *= brightness.g;
+	reflected.blue *= brightness.b;
+	return reflected;
+}
+const TextureMap* IMaterial::GetTexture() { return nullptr; }
\ No newline at end of file
@@ -4,17 +4,26 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <Objects.h>
+#include <Random.h>
 
-struct ModelTriangle;
+struct SceneView;
+struct RayTriangleIntersection;
+class TextureMap;
 
 class IMaterial {
 	public:
 		bool recievesShadow;
 		IMaterial();
 		virtual ~IMaterial() = 0;
-		virtual Colour GetColour(std::vector<ModelTriangle> model,
-			std::vector<glm::vec3> lights,
-			Camera cam,
+		// The colour at the intersection, which holds the triangle index and where on the triangle the point is.
+		// Anything random the colour needs, like where the lights are sampled, is drawn from random.
+		virtual Colour GetColour(const SceneView& scene,
 			LightingMode lightingMode,
-			int triangleIndex, glm::vec3 point) = 0;
+			const RayTriangleIntersection& intersection, RandomStream random) = 0;
+		// Materials that show another surface, like mirrors, return true with the direction to look in from point.
+		virtual bool GetReflection(const SceneView& scene, int triangleIndex, glm::vec3 point, glm::vec3& direction);
+		// The colour shown for the surface seen in the reflection, given its colour and the brightness of each channel.
+		virtual Colour ShadeReflection(Colour reflected, glm::vec3 brightness);
+		// Materials coloured by a texture return it, so the rasteriser can sample it itself. Others return nullptr.
+		virtual const TextureMap* GetTexture();
 };
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include <InstanceSet.h>
+#include <algorithm>
+
+InstanceSet::InstanceSet() : triangleCount(0), topLevelInstanceCount(0), geometryVersion(0) {}
+
+int InstanceSet::addMesh(const std::vector<ModelTriangle>& triangles) {
+	Mesh mesh;
+	mesh.triangles = triangles;
+	mesh.bvh = BVH(triangles);
+	mesh.geometry = TriangleStore(triangles, mesh.bvh.triangleIndices);
+	meshes.push_back(std::move(mesh));
+	return meshes.size() - 1;
+}
+
+int InstanceSet::addInstance(int mesh, glm::mat4 transform) {
+	MeshInstance instance;
+	instance.mesh = mesh;
+	instance.firstIndex = triangleCount;
+	instances.push_back(instance);
+	setTransform(instances.size() - 1, transform);
+	triangleCount += meshes[mesh].triangles.size();
+	geometryVersion++;
+	return instances.size() - 1;
+}
+
+void InstanceSet::setTransform(int instance, glm::mat4 transform) {
+	instances[instance].transform = transform;
+	instances[instance].inverseTransform = glm::inverse(transform);
+	instances[instance].normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+}
+
+void InstanceSet::buildTopLevel() {
+	topLevel = BVH(getInstanceBounds());
+	topLevelInstanceCount = instances.size();
+}
+
+void InstanceSet::updateTopLevel() {
+	if ((topLevelInstanceCount != instances.size()) || !topLevel.refit(getInstanceBounds())) buildTopLevel();
+}
+
+std::vector<AABB> InstanceSet::getInstanceBounds() const {
+	std::vector<AABB> instanceBounds(instances.size());
+	for (int i = 0; i < instances.size(); i++) {
+		const Mesh& mesh = meshes[instances[i].mesh];
+		if (mesh.bvh.isEmpty()) continue;
+		// The world box has to hold all 8 corners of the transformed object box.
+		AABB bounds = mesh.bvh.nodes[0].bounds;
+		for (int corner = 0; corner < 8; corner++) {
+			glm::vec3 point = glm::vec3((corner & 1) ? bounds.max.x : bounds.min.x,
+				(corner & 2) ? bounds.max.y : bounds.min.y,
+				(corner & 4) ? bounds.max.z : bounds.min.z);
+			instanceBounds[i].grow(glm::vec3(instances[i].transform * glm::vec4(point, 1.0f)));
+		}
+	}
+	return instanceBounds;
+}
+
+bool InstanceSet::isEmpty() const { return topLevel.isEmpty(); }
+
+int InstanceSet::getTriangleCount() const { return triangleCount; }
+
+int InstanceSet::getInstanceCount() const { return instances.size(); }
+
+int InstanceSet::getGeometryVersion() const { return geometryVersion; }
+
+const std::vector<ModelTriangle>& InstanceSet::getMeshTriangles(int mesh) const { return meshes[mesh].triangles; }
+
+const MeshInstance& InstanceSet::getInstance(int instance) const { return instances[instance]; }
+
+// Instances are numbered in the order they were added, so the owner is found by binary search.
+const MeshInstance& InstanceSet::getOwner(int index) const {
+	std::vector<MeshInstance>::const_iterator owner = std::upper_bound(instances.begin(), instances.end(), index,
+		[](int value, const MeshInstance& instance) { return value < instance.firstIndex; });
+	return *(owner - 1);
+}
+
+ModelTriangle InstanceSet::getTriangle(int index) const {
+	const MeshInstance& instance = getOwner(index);
+	ModelTriangle triangle = meshes[instance.mesh].triangles[index - instance.firstIndex];
+	for (int i = 0; i < 3; i++) {
+		triangle.vertices[i].position = glm::vec3(instance.transform * glm::vec4(triangle.vertices[i].position, 1.0f));
+		triangle.vertices[i].normal = glm::normalize(instance.normalTransform * triangle.vertices[i].normal);
+	}
+	triangle.normal = glm::normalize(instance.normalTransform * triangle.normal);
+	return triangle;
+}
+
+IMaterial* InstanceSet::getMaterial(int index) const {
+	const MeshInstance& instance = getOwner(index);
+	return meshes[instance.mesh].triangles[index - instance.firstIndex].material;
+}
+
+glm::vec3 InstanceSet::getNormal(int index) const {
+	const MeshInstance& instance = getOwner(index);
+	return glm::normalize(instance.normalTransform * meshes[instance.mesh].triangles[index - instance.firstIndex].normal);
+}
+
+// The direction is not normalised, so a distance along the object space ray is the same distance
+// along the world space one and hits from different instances compare directly.
+Ray InstanceSet::toObjectSpace(const Ray& ray, const MeshInstance& instance) const {
+	glm::vec3 origin = glm::vec3(instance.inverseTransform * glm::vec4(ray.origin, 1.0f));
+	glm::vec3 direction = glm::mat3(instance.inverseTransform) * ray.direction;
+	return makeRay(origin, direction);
+}
+
+bool InstanceSet::getClosestHit(const Ray& ray, int indexBlacklist, TriangleHit& hit) const {
+	return topLevel.closestHit(ray, hit, [&](int first, int count) {
+		bool found = false;
+		for (int i = first; i < first + count; i++) {
+			int instanceIndex = topLevel.triangleIndices[i];
+			if (instanceIndex == -1) continue;
+			const MeshInstance& instance = instances[instanceIndex];
+			const Mesh& mesh = meshes[instance.mesh];
+			if (mesh.bvh.isEmpty()) continue;
+			if (mesh.bvh.getClosestHit(toObjectSpace(ray, instance), mesh.geometry, indexBlacklist - instance.firstIndex, hit)) {
+				hit.triangleIndex += instance.firstIndex;
+				found = true;
+			}
+		}
+		return found;
+	});
+}
+
+bool InstanceSet::isOccluded(const Ray& ray, int indexBlacklist, float maxDistance) const {
+	return topLevel.anyHit(ray, maxDistance, [&](int first, int count) {
+		for (int i = first; i < first + count; i++) {
+			int instanceIndex = topLevel.triangleIndices[i];
+			if (instanceIndex == -1) continue;
+			const MeshInstance& instance = instances[instanceIndex];
+			const Mesh& mesh = meshes[instance.mesh];
+			if (mesh.bvh.isEmpty()) continue;
+			if (mesh.bvh.isOccluded(toObjectSpace(ray, instance), mesh.geometry, indexBlacklist - instance.firstIndex, maxDistance)) return true;
+		}
+		return false;
+	});
+}
\ No newline at end of file
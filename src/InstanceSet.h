@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <ModelTriangle.h>
+#include <BVH.h>
+#include <TriangleStore.h>
+#include <Intersection.h>
+
+// A loaded mesh in its own object space, with the BVH built over it.
+struct Mesh {
+	std::vector<ModelTriangle> triangles;
+	BVH bvh;
+	TriangleStore geometry;
+};
+
+// A mesh placed in the world by an affine transform. Its triangles are numbered from firstIndex.
+struct MeshInstance {
+	int mesh;
+	glm::mat4 transform;
+	glm::mat4 inverseTransform;
+	glm::mat3 normalTransform;
+	int firstIndex;
+};
+
+// Two level acceleration. Every mesh has a bottom level BVH that is built once, and a top level BVH
+// over the world space bounds of the instances picks which ones a ray visits. Rays are moved into
+// each instance's object space, so any number of instances share one copy of a mesh's triangles.
+class InstanceSet {
+public:
+	InstanceSet();
+	// Returns the index to pass to addInstance.
+	int addMesh(const std::vector<ModelTriangle>& triangles);
+	int addInstance(int mesh, glm::mat4 transform);
+	void setTransform(int instance, glm::mat4 transform);
+	// Rebuilds the top level BVH, call it once all the instances have been added and before tracing.
+	void buildTopLevel();
+	// Refits the top level BVH after instances have only moved, and rebuilds it if instances were
+	// added or the refit has made it too slow.
+	void updateTopLevel();
+	bool isEmpty() const;
+	int getTriangleCount() const;
+	int getInstanceCount() const;
+	// Changes whenever an instance is added. Meshes can't be edited once added and moving an instance
+	// leaves its object space triangles alone, so nothing else changes what is welded or traced.
+	int getGeometryVersion() const;
+	const std::vector<ModelTriangle>& getMeshTriangles(int mesh) const;
+	const MeshInstance& getInstance(int instance) const;
+	// A world space copy of the triangle with the given index.
+	ModelTriangle getTriangle(int index) const;
+	// The triangle's material and world space normal, without copying the rest of it.
+	IMaterial* getMaterial(int index) const;
+	glm::vec3 getNormal(int index) const;
+	// The same as BVH::getClosestHit, triangle indices count across all instances.
+	bool getClosestHit(const Ray& ray, int indexBlacklist, TriangleHit& hit) const;
+	bool isOccluded(const Ray& ray, int indexBlacklist, float maxDistance) const;
+
+private:
+	std::vector<Mesh> meshes;
+	std::vector<MeshInstance> instances;
+	BVH topLevel;
+	int triangleCount;
+	int topLevelInstanceCount;
+	int geometryVersion;
+
+	std::vector<AABB> getInstanceBounds() const;
+	Ray toObjectSpace(const Ray& ray, const MeshInstance& instance) const;
+	const MeshInstance& getOwner(int index) const;
+};
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include <Intersection.h>
+
+Ray makeRay(glm::vec3 origin, glm::vec3 direction) {
+	Ray ray;
+	ray.origin = origin;
+	ray.direction = direction;
+	ray.inverseDirection = 1.0f / direction;
+#ifdef WATERTIGHT_INTERSECTION
+	// Shear the ray onto the z axis, picking the largest direction component so the divisions are stable.
+	glm::vec3 absolute = glm::abs(direction);
+	ray.kz = absolute.x > absolute.y ? (absolute.x > absolute.z ? 0 : 2) : (absolute.y > absolute.z ? 1 : 2);
+	ray.kx = (ray.kz + 1) % 3;
+	ray.ky = (ray.kx + 1) % 3;
+	if (direction[ray.kz] < 0.0f) std::swap(ray.kx, ray.ky);
+	ray.shear = glm::vec3(direction[ray.kx] / direction[ray.kz],
+		direction[ray.ky] / direction[ray.kz],
+		1.0f / direction[ray.kz]);
+#endif
+	return ray;
+}
+
+// Lanes past count repeat the last ray, so they can be tested like any other and just never reported.
+RayPacket makeRayPacket(glm::vec3 origin, const glm::vec3* directions, int count) {
+	RayPacket packet;
+	packet.origin = origin;
+	packet.count = count;
+	packet.coherent = true;
+	packet.minInverseDirection = glm::vec3(std::numeric_limits<float>::max());
+	packet.maxInverseDirection = glm::vec3(-std::numeric_limits<float>::max());
+	for (int lane = 0; lane < PACKET_SIZE; lane++) {
+		Ray& ray = packet.rays[lane];
+		ray = makeRay(origin, directions[std::min(lane, count - 1)]);
+		for (int axis = 0; axis < 3; axis++) {
+			packet.directions[axis][lane] = ray.direction[axis];
+			packet.inverseDirections[axis][lane] = ray.inverseDirection[axis];
+			if ((ray.direction[axis] == 0.0f) || ((ray.direction[axis] > 0.0f) != (packet.rays[0].direction[axis] > 0.0f))) packet.coherent = false;
+		}
+		packet.minInverseDirection = glm::min(packet.minInverseDirection, ray.inverseDirection);
+		packet.maxInverseDirection = glm::max(packet.maxInverseDirection, ray.inverseDirection);
+	}
+	return packet;
+}
+
+TriangleHit noHit(float maxDistance) {
+	TriangleHit hit;
+	hit.t = maxDistance;
+	hit.u = 0;
+	hit.v = 0;
+	hit.triangleIndex = -1;
+	return hit;
+}
+
+PacketHit noPacketHit() {
+	PacketHit hits;
+	for (int lane = 0; lane < PACKET_SIZE; lane++) {
+		hits.t[lane] = std::numeric_limits<float>::max();
+		hits.u[lane] = 0;
+		hits.v[lane] = 0;
+		hits.triangleIndex[lane] = -1;
+	}
+	return hits;
+}
+
+TriangleHit getPacketHit(const PacketHit& hits, int lane) {
+	TriangleHit hit;
+	hit.t = hits.t[lane];
+	hit.u = hits.u[lane];
+	hit.v = hits.v[lane];
+	hit.triangleIndex = hits.triangleIndex[lane];
+	return hit;
+}
+
+std::vector<TriangleEdges> precomputeEdges(const std::vector<ModelTriangle>& model) {
+	std::vector<TriangleEdges> result(model.size());
+	for (int i = 0; i < model.size(); i++) {
+		result[i].v0 = model[i].vertices[0].position;
+		result[i].e0 = model[i].vertices[1].position - model[i].vertices[0].position;
+		result[i].e1 = model[i].vertices[2].position - model[i].vertices[0].position;
+	}
+	return result;
+}
\ No newline at end of file
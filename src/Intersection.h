@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <ModelTriangle.h>
+
+// Define WATERTIGHT_INTERSECTION to use the watertight test of Woop, Benthin and Wald instead of
+// Moller-Trumbore. It never lets a ray slip through the shared edge of two triangles.
+
+// A ray with everything the kernels need precomputed once rather than per triangle.
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 inverseDirection;
+#ifdef WATERTIGHT_INTERSECTION
+	int kx, ky, kz;
+	glm::vec3 shear;
+#endif
+};
+
+// The first vertex and the two edges leaving it, which is all the intersection kernel reads.
+struct TriangleEdges {
+	glm::vec3 v0;
+	glm::vec3 e0;
+	glm::vec3 e1;
+};
+
+// Where a ray hit a triangle. u and v are the barycentric weights of vertices 1 and 2.
+struct TriangleHit {
+	float t;
+	float u;
+	float v;
+	int triangleIndex;
+};
+
+// How many rays a packet holds, 8 or 16. AVX2 builds test them eight at a time.
+#ifndef PACKET_SIZE
+#define PACKET_SIZE 8
+#endif
+
+// Rays that share an origin, like the camera rays through a block of neighbouring pixels. The
+// directions are also kept by component so one box or triangle can be tested against several
+// rays in one go. Only the first count lanes hold rays.
+struct RayPacket {
+	Ray rays[PACKET_SIZE];
+	glm::vec3 origin;
+	float directions[3][PACKET_SIZE];
+	float inverseDirections[3][PACKET_SIZE];
+	// When no direction component changes sign across the packet, the range each inverse
+	// component covers bounds every ray at once, so a box the range misses is culled for all of them.
+	bool coherent;
+	glm::vec3 minInverseDirection;
+	glm::vec3 maxInverseDirection;
+	int count;
+};
+
+// The closest hit so far for each ray of a packet, by component like the packet.
+struct PacketHit {
+	float t[PACKET_SIZE];
+	float u[PACKET_SIZE];
+	float v[PACKET_SIZE];
+	int triangleIndex[PACKET_SIZE];
+};
+
+Ray makeRay(glm::vec3 origin, glm::vec3 direction);
+
+RayPacket makeRayPacket(glm::vec3 origin, const glm::vec3* directions, int count);
+
+TriangleHit noHit(float maxDistance = std::numeric_limits<float>::max());
+
+PacketHit noPacketHit();
+
+TriangleHit getPacketHit(const PacketHit& hits, int lane);
+
+std::vector<TriangleEdges> precomputeEdges(const std::vector<ModelTriangle>& model);
+
+// Records the hit if the ray meets the triangle closer than hit.t. Defined here so the
+// traversal loops can inline it.
+inline bool intersectTriangle(const Ray& ray, const TriangleEdges& triangle, int triangleIndex, TriangleHit& hit) {
+#ifndef WATERTIGHT_INTERSECTION
+	glm::vec3 p = glm::cross(ray.direction, triangle.e1);
+	float determinant = glm::dot(triangle.e0, p);
+	if (determinant == 0.0f) return false;
+	float inverseDeterminant = 1.0f / determinant;
+
+	glm::vec3 startToV0 = ray.origin - triangle.v0;
+	float u = glm::dot(startToV0, p) * inverseDeterminant;
+	if ((u < 0.0f) || (u > 1.0f)) return false;
+
+	glm::vec3 q = glm::cross(startToV0, triangle.e0);
+	float v = glm::dot(ray.direction, q) * inverseDeterminant;
+	if ((v < 0.0f) || (u + v > 1.0f)) return false;
+
+	float t = glm::dot(triangle.e1, q) * inverseDeterminant;
+	if (!((t > 0.0f) && (t < hit.t))) return false;
+#else
+	glm::vec3 a = triangle.v0 - ray.origin;
+	glm::vec3 b = a + triangle.e0;
+	glm::vec3 c = a + triangle.e1;
+	float ax = a[ray.kx] - (ray.shear.x * a[ray.kz]);
+	float ay = a[ray.ky] - (ray.shear.y * a[ray.kz]);
+	float bx = b[ray.kx] - (ray.shear.x * b[ray.kz]);
+	float by = b[ray.ky] - (ray.shear.y * b[ray.kz]);
+	float cx = c[ray.kx] - (ray.shear.x * c[ray.kz]);
+	float cy = c[ray.ky] - (ray.shear.y * c[ray.kz]);
+
+	float w0 = (cx * by) - (cy * bx);
+	float w1 = (ax * cy) - (ay * cx);
+	float w2 = (bx * ay) - (by * ax);
+	// Fall back to double precision exactly on an edge, where float cancellation decides the result.
+	if ((w0 == 0.0f) || (w1 == 0.0f) || (w2 == 0.0f)) {
+		w0 = (float)(((double)cx * by) - ((double)cy * bx));
+		w1 = (float)(((double)ax * cy) - ((double)ay * cx));
+		w2 = (float)(((double)bx * ay) - ((double)by * ax));
+	}
+	if (((w0 < 0.0f) || (w1 < 0.0f) || (w2 < 0.0f)) && ((w0 > 0.0f) || (w1 > 0.0f) || (w2 > 0.0f))) return false;
+
+	float determinant = w0 + w1 + w2;
+	if (determinant == 0.0f) return false;
+	float scaledT = ray.shear.z * ((w0 * a[ray.kz]) + (w1 * b[ray.kz]) + (w2 * c[ray.kz]));
+	float t = scaledT / determinant;
+	if (!((t > 0.0f) && (t < hit.t))) return false;
+	float u = w1 / determinant;
+	float v = w2 / determinant;
+#endif
+
+	hit.t = t;
+	hit.u = u;
+	hit.v = v;
+	hit.triangleIndex = triangleIndex;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,258 @@
+#include <IrradianceCache.h>
+#include <Raytracing.h>
+#include <ThreadPool.h>
+#include <Sampling.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#define PI 3.14159265358979323846264338327950288f
+// The coarsest grid of pixels update looks for uncovered surfaces on, halved each pass down to the finest.
+#define IRRADIANCE_COARSE_SPACING 16
+#define IRRADIANCE_FINE_SPACING 4
+// How many candidate pixels one thread pool job checks.
+#define IRRADIANCE_JOB_SIZE 64
+// How far the hemisphere rays start off the surface.
+#define IRRADIANCE_BIAS 0.001f
+
+bool shadesIndirect(LightingMode lightingMode) {
+	return (lightingMode == AMBIENT) || (lightingMode == GOURAUD) || (lightingMode == PHONG);
+}
+
+// The hemisphere rays are spread by cosine, so the average of what they see is the irradiance over pi
+// without weighting each one. Surfaces they hit are lit as INCIDENCE lights them, with the shadows
+// GOURAUD and PHONG use, and mirrors send no diffuse light back.
+IrradianceRecord gatherIrradiance(const RayTriangleIntersection& intersection, const SceneView& scene, RandomStream random) {
+	IrradianceRecord record;
+	record.position = intersection.intersectionPoint;
+	record.normal = scene.getNormal(intersection.triangleIndex);
+	glm::vec3 helper = std::abs(record.normal.x) > 0.9f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+	glm::vec3 tangent = glm::normalize(glm::cross(helper, record.normal));
+	glm::vec3 bitangent = glm::cross(record.normal, tangent);
+	glm::vec3 start = record.position + (record.normal * IRRADIANCE_BIAS);
+
+	ShadowRayTracer shadowRays;
+	glm::vec3 irradiance = glm::vec3(0, 0, 0);
+	float inverseDistances = 0;
+	for (int i = 0; i < IRRADIANCE_SAMPLES; i++) {
+		glm::vec2 sample = getSamplePoint(SOBOL_SAMPLING, random, i, IRRADIANCE_SAMPLES);
+		float r = std::sqrt(sample.x);
+		float angle = 2 * PI * sample.y;
+		glm::vec3 direction = (tangent * (r * std::cos(angle))) + (bitangent * (r * std::sin(angle))) + (record.normal * std::sqrt(1 - sample.x));
+		RayTriangleIntersection hit = getClosestIntersection(start, direction, scene, intersection.triangleIndex);
+		if (hit.distance == std::numeric_limits<float>::max()) continue;
+		inverseDistances += 1 / std::max(hit.distance, IRRADIANCE_MIN_RADIUS);
+		IMaterial* material = getMaterial(hit, scene);
+		if (!material->recievesShadow) continue;
+		// Diffuse materials' colours don't depend on the lighting mode.
+		Colour colour = material->GetColour(scene, INCIDENCE, hit, random.bounce());
+		float brightness = diffuseLighting(hit, scene, shadowRays, random.bounce());
+		irradiance += glm::vec3(colour.red, colour.green, colour.blue) * (brightness / 255.0f);
+	}
+	record.irradiance = irradiance / (float)IRRADIANCE_SAMPLES;
+	record.radius = IRRADIANCE_MAX_RADIUS;
+	if (inverseDistances > 0) record.radius = glm::clamp(IRRADIANCE_SAMPLES / inverseDistances, IRRADIANCE_MIN_RADIUS, IRRADIANCE_MAX_RADIUS);
+	return record;
+}
+
+IrradianceCache::IrradianceCache() {}
+
+void IrradianceCache::clear() {
+	records.clear();
+	nodes.clear();
+}
+
+int IrradianceCache::getRecordCount() const { return records.size(); }
+
+// A candidate pixel's surface, looked for by update.
+struct IrradianceCandidate {
+	int x;
+	int y;
+	bool needed;
+	IrradianceRecord record;
+};
+
+void IrradianceCache::update(const SceneView& scene, DrawingWindow& window, int threadCount) {
+	if (nodes.empty()) {
+		rootBounds = AABB();
+		for (int i = 0; i < scene.getTriangleCount(); i++) {
+			ModelTriangle triangle = scene.getTriangle(i);
+			for (int j = 0; j < 3; j++) rootBounds.grow(triangle.vertices[j].position);
+		}
+		// Room for the regions of records at the very edge of the scene.
+		rootBounds.min -= glm::vec3(IRRADIANCE_MAX_RADIUS * IRRADIANCE_ACCURACY);
+		rootBounds.max += glm::vec3(IRRADIANCE_MAX_RADIUS * IRRADIANCE_ACCURACY);
+		IrradianceNode root;
+		root.firstChild = -1;
+		nodes.push_back(root);
+	}
+
+	glm::mat3 cameraToWorld = glm::inverse(scene.cam.orientation);
+	ThreadPool& pool = getThreadPool(threadCount);
+	std::vector<IrradianceCandidate> candidates;
+	for (int spacing = IRRADIANCE_COARSE_SPACING; spacing >= IRRADIANCE_FINE_SPACING; spacing /= 2) {
+		// Pixels already looked at on a coarser grid are skipped.
+		candidates.clear();
+		for (int y = 0; y < window.height; y += spacing) {
+			for (int x = 0; x < window.width; x += spacing) {
+				bool coarser = (spacing < IRRADIANCE_COARSE_SPACING) && (x % (spacing * 2) == 0) && (y % (spacing * 2) == 0);
+				if (!coarser) candidates.push_back({ x, y, false, IrradianceRecord() });
+			}
+		}
+
+		// Only records from earlier passes are looked up, so the ones added don't depend on the order jobs finish in.
+		int jobCount = (candidates.size() + IRRADIANCE_JOB_SIZE - 1) / IRRADIANCE_JOB_SIZE;
+		pool.run(jobCount, [&](int jobIndex, int threadIndex) {
+			int end = std::min((int)candidates.size(), (jobIndex + 1) * IRRADIANCE_JOB_SIZE);
+			for (int i = jobIndex * IRRADIANCE_JOB_SIZE; i < end; i++) {
+				IrradianceCandidate& candidate = candidates[i];
+				glm::vec3 direction = getCameraRayDirection(candidate.x, candidate.y, scene, cameraToWorld, window);
+				RayTriangleIntersection hit = getClosestIntersection(scene.cam.position, direction, scene);
+				if (hit.distance == std::numeric_limits<float>::max()) continue;
+				glm::vec3 reflection;
+				if (getMaterial(hit, scene)->GetReflection(scene, hit.triangleIndex, hit.intersectionPoint, reflection)) {
+					hit = getClosestIntersection(hit.intersectionPoint, reflection, scene, hit.triangleIndex);
+					if (hit.distance == std::numeric_limits<float>::max()) continue;
+				}
+				if (!getMaterial(hit, scene)->recievesShadow) continue;
+				glm::vec3 irradiance;
+				if (lookup(hit.intersectionPoint, scene.getNormal(hit.triangleIndex), irradiance)) continue;
+				candidate.needed = true;
+				candidate.record = gatherIrradiance(hit, scene, RandomStream(scene.frame, candidate.x, candidate.y));
+			}
+		});
+		for (int i = 0; i < candidates.size(); i++) {
+			if (candidates[i].needed) add(candidates[i].record);
+		}
+	}
+}
+
+// The region around the record it is trusted over.
+static AABB getRecordBounds(const IrradianceRecord& record) {
+	float reach = record.radius * IRRADIANCE_ACCURACY;
+	AABB recordBounds;
+	recordBounds.grow(record.position - glm::vec3(reach));
+	recordBounds.grow(record.position + glm::vec3(reach));
+	return recordBounds;
+}
+
+static bool contains(const AABB& outer, const AABB& inner) {
+	for (int axis = 0; axis < 3; axis++) {
+		if ((inner.min[axis] < outer.min[axis]) || (outer.max[axis] < inner.max[axis])) return false;
+	}
+	return true;
+}
+
+// A record reaching outside the root, after the geometry has been refitted or the cache filled
+// from another scene, would overlap no node and be lost. The root grows to take it in, with room to
+// spare so it rarely has to again, and every record is stored afresh.
+void IrradianceCache::add(const IrradianceRecord& record) {
+	int recordIndex = records.size();
+	records.push_back(record);
+	AABB recordBounds = getRecordBounds(record);
+	if (contains(rootBounds, recordBounds)) {
+		addToNode(0, rootBounds, recordIndex, recordBounds, 0);
+		return;
+	}
+	rootBounds.grow(recordBounds.min);
+	rootBounds.grow(recordBounds.max);
+	glm::vec3 room = (rootBounds.max - rootBounds.min) * 0.25f;
+	rootBounds.min -= room;
+	rootBounds.max += room;
+	IrradianceNode root;
+	root.firstChild = -1;
+	nodes.assign(1, root);
+	for (int i = 0; i < records.size(); i++) addToNode(0, rootBounds, i, getRecordBounds(records[i]), 0);
+}
+
+static AABB getChildBounds(const AABB& bounds, int child) {
+	glm::vec3 centre = (bounds.min + bounds.max) * 0.5f;
+	AABB childBounds;
+	for (int axis = 0; axis < 3; axis++) {
+		bool upper = (child >> axis) & 1;
+		childBounds.min[axis] = upper ? centre[axis] : bounds.min[axis];
+		childBounds.max[axis] = upper ? bounds.max[axis] : centre[axis];
+	}
+	return childBounds;
+}
+
+static bool overlaps(const AABB& a, const AABB& b) {
+	for (int axis = 0; axis < 3; axis++) {
+		if ((a.max[axis] < b.min[axis]) || (b.max[axis] < a.min[axis])) return false;
+	}
+	return true;
+}
+
+// Stops at nodes smaller than the region the record covers, as pbrt's octree does, so a record is
+// only ever stored in a handful of nodes.
+void IrradianceCache::addToNode(int nodeIndex, const AABB& nodeBounds, int recordIndex, const AABB& recordBounds, int depth) {
+	glm::vec3 nodeDiagonal = nodeBounds.max - nodeBounds.min;
+	glm::vec3 recordDiagonal = recordBounds.max - recordBounds.min;
+	if ((depth == IRRADIANCE_OCTREE_DEPTH) || (glm::dot(nodeDiagonal, nodeDiagonal) < glm::dot(recordDiagonal, recordDiagonal))) {
+		nodes[nodeIndex].records.push_back(recordIndex);
+		return;
+	}
+	if (nodes[nodeIndex].firstChild == -1) {
+		nodes[nodeIndex].firstChild = nodes.size();
+		IrradianceNode child;
+		child.firstChild = -1;
+		nodes.resize(nodes.size() + 8, child);
+	}
+	for (int child = 0; child < 8; child++) {
+		AABB childBounds = getChildBounds(nodeBounds, child);
+		if (overlaps(childBounds, recordBounds)) addToNode(nodes[nodeIndex].firstChild + child, childBounds, recordIndex, recordBounds, depth + 1);
+	}
+}
+
+// Ward's weight falls with the distance over the record's radius and with the angle between the
+// normals. Records behind the point, which may see a different neighbourhood, are skipped. Also finds
+// the record with the least error facing the same way, whether or not it covers the point.
+bool IrradianceCache::search(glm::vec3 point, glm::vec3 normal, glm::vec3& irradiance, int& nearestRecord) const {
+	nearestRecord = -1;
+	AABB pointBounds;
+	pointBounds.grow(point);
+	if (nodes.empty() || !contains(rootBounds, pointBounds)) return false;
+	glm::vec3 weighted = glm::vec3(0, 0, 0);
+	float totalWeight = 0;
+	float nearestError = std::numeric_limits<float>::max();
+	int nodeIndex = 0;
+	AABB bounds = rootBounds;
+	while (true) {
+		const IrradianceNode& node = nodes[nodeIndex];
+		for (int i = 0; i < node.records.size(); i++) {
+			const IrradianceRecord& record = records[node.records[i]];
+			glm::vec3 offset = point - record.position;
+			if (glm::dot(offset, (normal + record.normal) * 0.5f) < -0.05f * record.radius) continue;
+			float facing = glm::dot(normal, record.normal);
+			float error = (glm::length(offset) / record.radius) + std::sqrt(std::max(0.0f, 1 - facing));
+			if ((facing > 0) && (error < nearestError)) {
+				nearestError = error;
+				nearestRecord = node.records[i];
+			}
+			if (error >= IRRADIANCE_ACCURACY) continue;
+			float weight = 1 / std::max(error, 1e-4f);
+			weighted += record.irradiance * weight;
+			totalWeight += weight;
+		}
+		if (node.firstChild == -1) break;
+		glm::vec3 centre = (bounds.min + bounds.max) * 0.5f;
+		int child = (point.x >= centre.x ? 1 : 0) | (point.y >= centre.y ? 2 : 0) | (point.z >= centre.z ? 4 : 0);
+		bounds = getChildBounds(bounds, child);
+		nodeIndex = node.firstChild + child;
+	}
+	if (totalWeight == 0) return false;
+	irradiance = weighted / totalWeight;
+	return true;
+}
+
+bool IrradianceCache::lookup(glm::vec3 point, glm::vec3 normal, glm::vec3& irradiance) const {
+	int nearestRecord;
+	return search(point, normal, irradiance, nearestRecord);
+}
+
+bool IrradianceCache::estimate(glm::vec3 point, glm::vec3 normal, glm::vec3& irradiance) const {
+	int nearestRecord;
+	if (search(point, normal, irradiance, nearestRecord)) return true;
+	irradiance = (nearestRecord == -1) ? glm::vec3(0, 0, 0) : records[nearestRecord].irradiance;
+	return false;
+}
\ No newline at end of file
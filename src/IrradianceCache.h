@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <DrawingWindow.h>
+#include <Objects.h>
+#include <Random.h>
+#include <BVH.h>
+#include <SceneView.h>
+#include <RayTriangleIntersection.h>
+
+// Rays sent over the hemisphere to gather the light reaching one record.
+#define IRRADIANCE_SAMPLES 64
+// Ward's a, how far a record is trusted. Smaller values place records more densely.
+#define IRRADIANCE_ACCURACY 0.3f
+// Bounds on a record's radius, the harmonic mean distance to the surfaces its rays hit.
+#define IRRADIANCE_MIN_RADIUS 0.03f
+#define IRRADIANCE_MAX_RADIUS 0.5f
+// Octree nodes stop splitting at this depth.
+#define IRRADIANCE_OCTREE_DEPTH 12
+
+// Whether shading in lightingMode adds indirect light, in place of the constant ambient term.
+bool shadesIndirect(LightingMode lightingMode);
+
+// The diffuse light reaching a point from the other surfaces in the scene, measured over the
+// hemisphere above its normal. Each channel is the average brightness of the colour seen.
+struct IrradianceRecord {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec3 irradiance;
+	float radius;
+};
+
+// Records may be stored at several nodes, every one that overlaps the region they are trusted over,
+// at the depth where the nodes are about as big as that region. Nodes with children store their
+// index in firstChild and the other seven follow it, nodes without have a firstChild of -1.
+struct IrradianceNode {
+	int firstChild;
+	std::vector<int> records;
+};
+
+// Ward's irradiance cache. Indirect diffuse light changes slowly across a surface, so it is gathered
+// over the hemisphere at sparse points and interpolated between them, each record weighted by how
+// near it lies and how closely its normal matches. Records are kept in an octree, so a lookup only
+// visits the records stored along the path down to the point.
+//
+// update places records wherever the camera sees a surface that none of them cover yet. It does so
+// in passes over coarser and then finer grids of pixels, so the records depend only on the view and
+// not on how many threads gathered them. A cache the caller keeps only needs to fill the gaps each
+// new view uncovers, so an animation with fixed geometry and lights shares its records across frames.
+class IrradianceCache {
+public:
+	IrradianceCache();
+	// Adds records for the surfaces the camera sees, directly or in a mirror, that aren't covered yet.
+	void update(const SceneView& scene, DrawingWindow& window, int threadCount);
+	// Forgets every record, for when the geometry, lights or materials change.
+	void clear();
+	int getRecordCount() const;
+	// Interpolates the records covering the point, returns false when none do.
+	bool lookup(glm::vec3 point, glm::vec3 normal, glm::vec3& irradiance) const;
+	// The same, but where no record covers the point it takes the light of the record that comes
+	// closest to covering it among those the lookup visits, or black when it visits none that face
+	// the same way. Returns whether records covered the point.
+	bool estimate(glm::vec3 point, glm::vec3 normal, glm::vec3& irradiance) const;
+
+private:
+	std::vector<IrradianceRecord> records;
+	std::vector<IrradianceNode> nodes;
+	// Every record's region lies inside, so points outside are covered by none.
+	AABB rootBounds;
+
+	void add(const IrradianceRecord& record);
+	void addToNode(int nodeIndex, const AABB& nodeBounds, int recordIndex, const AABB& recordBounds, int depth);
+	bool search(glm::vec3 point, glm::vec3 normal, glm::vec3& irradiance, int& nearestRecord) const;
+};
+
+// Gathers the indirect light at the intersection from scratch, as a record of the cache would.
+IrradianceRecord gatherIrradiance(const RayTriangleIntersection& intersection, const SceneView& scene, RandomStream random);
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include <LightTree.h>
+#include <algorithm>
+#include <cmath>
+
+#define PI 3.14159265358979323846264338327950288f
+// Keeps the inverse square finite for points sitting on a light.
+#define MIN_LIGHT_DISTANCE_SQUARED 1e-6f
+
+Light Light::point(glm::vec3 position, float power) {
+	Light light;
+	light.type = POINT_LIGHT;
+	for (int i = 0; i < 3; i++) light.vertices[i] = position;
+	light.normal = glm::vec3(0, 0, 0);
+	light.power = power;
+	return light;
+}
+
+Light Light::triangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, float power) {
+	Light light;
+	light.type = TRIANGLE_LIGHT;
+	light.vertices[0] = v0;
+	light.vertices[1] = v1;
+	light.vertices[2] = v2;
+	light.normal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+	light.power = power;
+	return light;
+}
+
+glm::vec3 Light::getCentre() const {
+	return (vertices[0] + vertices[1] + vertices[2]) / 3.0f;
+}
+
+AABB Light::getBounds() const {
+	AABB bounds;
+	for (int i = 0; i < 3; i++) bounds.grow(vertices[i]);
+	return bounds;
+}
+
+// The square root spreads the points evenly over the triangle rather than bunching them at vertices[0].
+glm::vec3 Light::getPoint(glm::vec2 sample) const {
+	if (type == POINT_LIGHT) return vertices[0];
+	float root = std::sqrt(sample.x);
+	float b1 = sample.y * root;
+	float b2 = 1 - root;
+	return (vertices[0] * (1 - b1 - b2)) + (vertices[1] * b1) + (vertices[2] * b2);
+}
+
+float Light::getWeight(glm::vec3 lightPoint, glm::vec3 point) const {
+	glm::vec3 toPoint = point - lightPoint;
+	float distanceSquared = std::max(glm::dot(toPoint, toPoint), MIN_LIGHT_DISTANCE_SQUARED);
+	if (type == POINT_LIGHT) return power / distanceSquared;
+	float cosine = glm::dot(normal, toPoint) / std::sqrt(distanceSquared);
+	return cosine > 0 ? (power * cosine) / distanceSquared : 0;
+}
+
+static LightCone getCone(const Light& light) {
+	LightCone cone;
+	cone.cosFalloff = 0;
+	if (light.type == POINT_LIGHT) {
+		cone.axis = glm::vec3(0, 0, 1);
+		cone.cosAngle = -1;
+	}
+	else {
+		cone.axis = light.normal;
+		cone.cosAngle = 1;
+	}
+	return cone;
+}
+
+// The narrowest cone around both, found by widening the wider one until it takes in the other.
+static LightCone mergeCones(LightCone a, LightCone b) {
+	if (b.cosAngle < a.cosAngle) std::swap(a, b);
+	float angleA = std::acos(glm::clamp(a.cosAngle, -1.0f, 1.0f));
+	float angleB = std::acos(glm::clamp(b.cosAngle, -1.0f, 1.0f));
+	float between = std::acos(glm::clamp(glm::dot(a.axis, b.axis), -1.0f, 1.0f));
+	LightCone merged = a;
+	merged.cosFalloff = std::min(a.cosFalloff, b.cosFalloff);
+	if (std::min(between + angleB, PI) <= angleA) return merged;
+
+	float angle = (angleA + between + angleB) / 2;
+	glm::vec3 rotationAxis = glm::cross(a.axis, b.axis);
+	float sine = glm::length(rotationAxis);
+	if ((angle >= PI) || (sine < 1e-6f)) {
+		merged.cosAngle = -1;
+		return merged;
+	}
+	// Turns a's axis towards b's, about the axis perpendicular to both.
+	float turn = angle - angleA;
+	rotationAxis /= sine;
+	merged.axis = glm::normalize((a.axis * std::cos(turn)) + (glm::cross(rotationAxis, a.axis) * std::sin(turn)));
+	merged.cosAngle = std::cos(angle);
+	return merged;
+}
+
+// The cosine and sine of the angle between two others, a minus b, held at zero when b is the larger.
+static float cosDifference(float cosA, float sinA, float cosB, float sinB) {
+	return cosA > cosB ? 1 : (cosA * cosB) + (sinA * sinB);
+}
+
+static float sinDifference(float cosA, float sinA, float cosB, float sinB) {
+	return cosA > cosB ? 0 : (sinA * cosB) - (cosA * sinB);
+}
+
+static float sinFromCos(float cosine) {
+	return std::sqrt(std::max(0.0f, 1 - (cosine * cosine)));
+}
+
+LightTree::LightTree() {}
+
+LightTree::LightTree(const std::vector<Light>& lights) : lights(lights) {
+	if (lights.empty()) return;
+	std::vector<int> order(lights.size());
+	for (int i = 0; i < lights.size(); i++) order[i] = i;
+	// A binary tree over n leaves never needs more than 2n - 1 nodes.
+	nodes.reserve(2 * lights.size());
+	nodes.push_back(LightNode());
+	subdivide(0, order, 0, lights.size());
+}
+
+static std::vector<Light> toPointLights(const std::vector<glm::vec3>& positions) {
+	std::vector<Light> lights;
+	lights.reserve(positions.size());
+	for (int i = 0; i < positions.size(); i++) lights.push_back(Light::point(positions[i]));
+	return lights;
+}
+
+LightTree::LightTree(const std::vector<glm::vec3>& positions) : LightTree(toPointLights(positions)) {}
+
+bool LightTree::isEmpty() const { return nodes.empty(); }
+
+int LightTree::getLightCount() const { return lights.size(); }
+
+// Halves the lights at the median of their centres along the axis those centres spread furthest on.
+void LightTree::subdivide(int nodeIndex, std::vector<int>& order, int first, int count) {
+	if (count == 1) {
+		const Light& light = lights[order[first]];
+		LightNode& node = nodes[nodeIndex];
+		node.bounds = light.getBounds();
+		node.cone = getCone(light);
+		node.power = light.power;
+		node.leftFirst = order[first];
+		node.count = 1;
+		return;
+	}
+
+	AABB centres;
+	for (int i = first; i < first + count; i++) centres.grow(lights[order[i]].getCentre());
+	glm::vec3 extent = centres.max - centres.min;
+	int axis = 0;
+	if (extent.y > extent[axis]) axis = 1;
+	if (extent.z > extent[axis]) axis = 2;
+	int leftCount = count / 2;
+	std::nth_element(order.begin() + first, order.begin() + first + leftCount, order.begin() + first + count, [&](int a, int b) {
+		return lights[a].getCentre()[axis] < lights[b].getCentre()[axis];
+	});
+
+	int leftChild = nodes.size();
+	nodes.push_back(LightNode());
+	nodes.push_back(LightNode());
+	subdivide(leftChild, order, first, leftCount);
+	subdivide(leftChild + 1, order, first + leftCount, count - leftCount);
+
+	const LightNode& left = nodes[leftChild];
+	const LightNode& right = nodes[leftChild + 1];
+	LightNode& node = nodes[nodeIndex];
+	node.bounds = left.bounds;
+	node.bounds.grow(right.bounds);
+	node.cone = mergeCones(left.cone, right.cone);
+	node.power = left.power + right.power;
+	node.leftFirst = leftChild;
+	node.count = 0;
+}
+
+// Conty and Kulla's bound: the power over the squared distance to the box's centre, times the
+// cosine of the smallest angle any light in the box could leave at towards the point. The distance
+// is held to at least the box's radius so points inside a node don't pick it by luck of its centre.
+// The angles are subtracted through their cosines and sines, as pbrt-v4 does.
+float LightTree::getImportance(const LightNode& node, glm::vec3 point) const {
+	glm::vec3 centre = (node.bounds.min + node.bounds.max) * 0.5f;
+	glm::vec3 halfDiagonal = (node.bounds.max - node.bounds.min) * 0.5f;
+	float radiusSquared = glm::dot(halfDiagonal, halfDiagonal);
+	glm::vec3 toPoint = point - centre;
+	float pointDistanceSquared = glm::dot(toPoint, toPoint);
+	float distanceSquared = std::max(pointDistanceSquared, std::max(radiusSquared, MIN_LIGHT_DISTANCE_SQUARED));
+	if (node.cone.cosAngle <= -1) return node.power / distanceSquared;
+
+	float cosToPoint = glm::dot(node.cone.axis, toPoint) / std::sqrt(distanceSquared);
+	// The box covers this much of the view from the point, any light in it could be that much nearer the axis.
+	float cosBox = -1;
+	if (pointDistanceSquared > radiusSquared) cosBox = std::sqrt(1 - (radiusSquared / pointDistanceSquared));
+	float cosAngle = node.cone.cosAngle;
+	float sinAngle = sinFromCos(cosAngle);
+	float sinToPoint = sinFromCos(cosToPoint);
+	float cosOutside = cosDifference(cosToPoint, sinToPoint, cosAngle, sinAngle);
+	float sinOutside = sinDifference(cosToPoint, sinToPoint, cosAngle, sinAngle);
+	float cosClosest = cosDifference(cosOutside, sinOutside, cosBox, sinFromCos(cosBox));
+	if (cosClosest <= node.cone.cosFalloff) return 0;
+	return (node.power * cosClosest) / distanceSquared;
+}
+
+void LightTree::sample(glm::vec3 point, const float* u, int count, int* lightIndices, float* probabilities) const {
+	count = std::min(count, MAX_LIGHT_SAMPLES);
+	if (nodes.empty() || (getImportance(nodes[0], point) <= 0)) {
+		for (int i = 0; i < count; i++) {
+			lightIndices[i] = -1;
+			probabilities[i] = 0;
+		}
+		return;
+	}
+	float scaled[MAX_LIGHT_SAMPLES];
+	for (int i = 0; i < count; i++) scaled[i] = u[i];
+	sampleNode(0, point, scaled, count, 1, lightIndices, probabilities);
+}
+
+// Each number chooses a child in proportion to the children's importance and is stretched back
+// over [0, 1) to choose again further down. The numbers are in order, so the ones that go left
+// are all at the front.
+void LightTree::sampleNode(int nodeIndex, glm::vec3 point, float* u, int count, float probability, int* lightIndices, float* probabilities) const {
+	const LightNode& node = nodes[nodeIndex];
+	if (node.count > 0) {
+		for (int i = 0; i < count; i++) {
+			lightIndices[i] = node.leftFirst;
+			probabilities[i] = probability;
+		}
+		return;
+	}
+	float leftImportance = getImportance(nodes[node.leftFirst], point);
+	float rightImportance = getImportance(nodes[node.leftFirst + 1], point);
+	float total = leftImportance + rightImportance;
+	if (total <= 0) {
+		for (int i = 0; i < count; i++) {
+			lightIndices[i] = -1;
+			probabilities[i] = 0;
+		}
+		return;
+	}
+	float leftProbability = leftImportance / total;
+	int leftCount = 0;
+	while ((leftCount < count) && (u[leftCount] < leftProbability)) {
+		u[leftCount] = std::min(u[leftCount] / leftProbability, 0.99999994f);
+		leftCount++;
+	}
+	for (int i = leftCount; i < count; i++) u[i] = std::min((u[i] - leftProbability) / (1 - leftProbability), 0.99999994f);
+	if (leftCount > 0) sampleNode(node.leftFirst, point, u, leftCount, probability * leftProbability, lightIndices, probabilities);
+	if (leftCount < count) {
+		sampleNode(node.leftFirst + 1, point, u + leftCount, count - leftCount, probability * (1 - leftProbability),
+			lightIndices + leftCount, probabilities + leftCount);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <BVH.h>
+
+// The most lights LightTree::sample picks for a point at once.
+#define MAX_LIGHT_SAMPLES 64
+
+enum LightType { POINT_LIGHT, TRIANGLE_LIGHT };
+
+// A point light shines the same way in every direction. A triangle light is an emissive triangle
+// that only shines out of its front face, towards normal, and is sampled at points across it.
+struct Light {
+	LightType type;
+	glm::vec3 vertices[3];
+	glm::vec3 normal;
+	float power;
+
+	static Light point(glm::vec3 position, float power = 1);
+	// The normal follows the winding, anticlockwise seen from the lit side.
+	static Light triangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, float power = 1);
+	glm::vec3 getCentre() const;
+	AABB getBounds() const;
+	// The point at sample in the unit square, spread evenly over the light.
+	glm::vec3 getPoint(glm::vec2 sample) const;
+	// How strongly the light at lightPoint reaches point, before anything blocks it: its power, the
+	// cosine it leaves the light at and the inverse square of the distance.
+	float getWeight(glm::vec3 lightPoint, glm::vec3 point) const;
+};
+
+// Every direction a node's lights shine in lies within an angle of axis, and each light's own
+// emission reaches a falloff angle past its direction. Both are kept as cosines, so weighing a node
+// up needs no trigonometry.
+struct LightCone {
+	glm::vec3 axis;
+	float cosAngle;
+	float cosFalloff;
+};
+
+// Leaves hold one light, at index leftFirst, and have a count of 1. Interior nodes store the index
+// of their left child in leftFirst and the right child follows it, as BVHNode does.
+struct LightNode {
+	AABB bounds;
+	LightCone cone;
+	float power;
+	int leftFirst;
+	int count;
+};
+
+// A light hierarchy after Conty and Kulla's "Importance Sampling of Many Lights with Adaptive Tree
+// Splitting". Each node bounds its lights' positions, power and the directions they shine in, so
+// a point can guess how much light a whole subtree sends it. A light is picked by walking down from
+// the root and choosing each child in proportion to that guess, which costs a step per level
+// however many lights there are.
+class LightTree {
+public:
+	std::vector<LightNode> nodes;
+	std::vector<Light> lights;
+
+	LightTree();
+	LightTree(const std::vector<Light>& lights);
+	// Point lights of the same power at each position.
+	LightTree(const std::vector<glm::vec3>& positions);
+	bool isEmpty() const;
+	int getLightCount() const;
+	// Picks count lights for point, one for each number in u, which must be in [0, 1) and in
+	// increasing order. Sets lightIndices[i] to the light picked with u[i], or -1 when no light can
+	// reach the point, and probabilities[i] to the chance it had of being picked. The picks walk
+	// down together, so a node is only weighed up once however many of them pass through it.
+	void sample(glm::vec3 point, const float* u, int count, int* lightIndices, float* probabilities) const;
+	// How much light the node's lights could send point at most, up to a constant factor.
+	float getImportance(const LightNode& node, glm::vec3 point) const;
+
+private:
+	void subdivide(int nodeIndex, std::vector<int>& order, int first, int count);
+	void sampleNode(int nodeIndex, glm::vec3 point, float* u, int count, float probability, int* lightIndices, float* probabilities) const;
+};
\ No newline at end of file
@@ -8,31 +8,37 @@ MirrorMaterial::MirrorMaterial() { recievesShadow = false; }
 
 MirrorMaterial::~MirrorMaterial() {}
 
-Colour MirrorMaterial::GetColour(std::vector<ModelTriangle> model,
-	std::vector<glm::vec3> lights,
-	Camera cam,
+Colour MirrorMaterial::GetColour(const SceneView& scene,
 	LightingMode lightingMode,
-	int triangleIndex, glm::vec3 point) {
+	const RayTriangleIntersection& intersection, RandomStream random) {
 
-	glm::vec3 normal = model[triangleIndex].normal;
-	glm::vec3 unitCameraToPoint = glm::normalize(point);
-	// Rr = Ri - 2N(Ri . N)
-	glm::vec3 reflection = glm::normalize(unitCameraToPoint - (2.0f * normal * glm::dot(unitCameraToPoint, normal)));
-	RayTriangleIntersection intersection = getClosestIntersection(point, glm::normalize(reflection), model, triangleIndex);
-	intersection.intersectionPoint += point;
+	glm::vec3 reflection;
+	GetReflection(scene, intersection.triangleIndex, intersection.intersectionPoint, reflection);
+	RayTriangleIntersection reflected = getClosestIntersection(intersection.intersectionPoint, reflection, scene, intersection.triangleIndex);
 	Colour colour = Colour(0, 0, 0);
-	if ((intersection.distance < std::numeric_limits<float>::max()) && (intersection.intersectedTriangle.material->recievesShadow)) {
-		float brightness = calculateBrightness(intersection, lightingMode, model, lights);
-		colour = intersection.intersectedTriangle.GetColour(model, lights, cam, lightingMode,
-			intersection.triangleIndex,
-			intersection.intersectionPoint);
-		colour.red *= 0.9;
-		colour.green *= 0.9;
-		colour.blue *= 0.9;
-		colour.blue += 0.1 * 255;
-		colour.red *= brightness;
-		colour.green *= brightness;
-		colour.blue *= brightness;
+	IMaterial* material = getMaterial(reflected, scene);
+	if ((reflected.distance < std::numeric_limits<float>::max()) && (material->recievesShadow)) {
+		glm::vec3 brightness = calculateLighting(reflected, lightingMode, scene, random.bounce());
+		colour = ShadeReflection(material->GetColour(scene, lightingMode, reflected, random.bounce()), brightness);
 	}
 	return colour;
+}
+
+bool MirrorMaterial::GetReflection(const SceneView& scene, int triangleIndex, glm::vec3 point, glm::vec3& direction) {
+	glm::vec3 normal = scene.getTriangle(triangleIndex).normal;
+	glm::vec3 unitCameraToPoint = glm::normalize(point - scene.cam.position);
+	// Rr = Ri - 2N(Ri . N)
+	direction = glm::normalize(glm::normalize(unitCameraToPoint - (2.0f * normal * glm::dot(unitCameraToPoint, normal))));
+	return true;
+}
+
+Colour MirrorMaterial::ShadeReflection(Colour reflected, glm::vec3 brightness) {
+	reflected.red *= 0.9;
+	reflected.green *= 0.9;
+	reflected.blue *= 0.9;
+	reflected.blue += 0.1 * 255;
+	reflected.red *= brightness.r;
+	reflected.green *= brightness.g;
+	reflected.blue *= brightness.b;
+	return reflected;
 }
\ No newline at end of file
@@ -6,9 +6,9 @@ class MirrorMaterial : public IMaterial {
 public:
 	MirrorMaterial();
 	virtual ~MirrorMaterial();
-	virtual Colour GetColour(std::vector<ModelTriangle> model,
-		std::vector<glm::vec3> lights,
-		Camera cam,
+	virtual Colour GetColour(const SceneView& scene,
 		LightingMode lightingMode,
-		int triangleIndex, glm::vec3 point);
+		const RayTriangleIntersection& intersection, RandomStream random);
+	virtual bool GetReflection(const SceneView& scene, int triangleIndex, glm::vec3 point, glm::vec3& direction);
+	virtual Colour ShadeReflection(Colour reflected, glm::vec3 brightness);
 };
\ No newline at end of file
@@ -8,7 +8,9 @@ enum RenderMode {
 	POINTCLOUD,
 	WIREFRAME,
 	RASTERISED,
-	RAYTRACED
+	RAYTRACED,
+	WAVEFRONT,
+	DEFERRED
 };
 
 enum LightingMode {
@@ -31,6 +33,9 @@ struct RendererState {
 	RenderMode renderMode;
 	LightingMode lightingMode;
 	bool orbiting;
+	int threadCount;
+	// Gathers indirect light through an irradiance cache in place of the constant ambient term.
+	bool indirectLighting;
 };
 
 struct Vertex {
@@ -0,0 +1,37 @@
+#include <Random.h>
+
+uint32_t hashRandom(uint32_t value) {
+	uint32_t state = (value * 747796405u) + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+	return (word >> 22) ^ word;
+}
+
+RandomStream::RandomStream() : RandomStream(0, 0, 0) {}
+
+RandomStream::RandomStream(uint32_t frame, uint32_t x, uint32_t y) :
+	key(hashRandom(frame + hashRandom(x + hashRandom(y)))), frameKey(hashRandom(frame)), x(x), y(y) {}
+
+RandomStream RandomStream::bounce() const {
+	RandomStream next = *this;
+	next.key = hashRandom(key ^ 0x9e3779b9u);
+	next.frameKey = hashRandom(frameKey ^ 0x9e3779b9u);
+	return next;
+}
+
+float RandomStream::get(uint32_t sample, uint32_t dimension) const {
+	uint32_t bits = hashRandom(key + hashRandom(sample + hashRandom(dimension)));
+	// The top 24 bits fill a float's mantissa exactly, so the result never rounds up to 1.
+	return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+uint32_t RandomStream::getSeed(uint32_t dimension) const {
+	return hashRandom(key ^ hashRandom(dimension + 0x85ebca6bu));
+}
+
+uint32_t RandomStream::getFrameSeed(uint32_t dimension) const {
+	return hashRandom(frameKey ^ hashRandom(dimension + 0x85ebca6bu));
+}
+
+uint32_t RandomStream::getX() const { return x; }
+
+uint32_t RandomStream::getY() const { return y; }
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+// Random numbers that are a hash of what they are for, the frame, the pixel, the sample and which of
+// its coordinates, rather than the next draw from shared state. Threads need no locks to use them
+// and every pixel gets the same numbers however many threads render it and in whatever order.
+class RandomStream {
+public:
+	RandomStream();
+	RandomStream(uint32_t frame, uint32_t x, uint32_t y);
+	// The stream for the surface seen after one more bounce, so it doesn't repeat this one's numbers.
+	RandomStream bounce() const;
+	// A number in [0, 1) for the given sample and dimension.
+	float get(uint32_t sample, uint32_t dimension) const;
+	// Random bits for samplers that scramble sequences of their own, one set per pixel and one shared
+	// by every pixel of the frame, for the given dimension.
+	uint32_t getSeed(uint32_t dimension) const;
+	uint32_t getFrameSeed(uint32_t dimension) const;
+	uint32_t getX() const;
+	uint32_t getY() const;
+
+private:
+	uint32_t key;
+	uint32_t frameKey;
+	uint32_t x;
+	uint32_t y;
+};
+
+// A PCG style permutation of 32 bit integers whose output bits all depend on every input bit.
+uint32_t hashRandom(uint32_t value);
\ No newline at end of file
@@ -3,24 +3,36 @@
 #include <CanvasTriangle.h>
 #include <Colour.h>
 #include <TextureMap.h>
+#include <RayTriangleIntersection.h>
 #include <Utilities.h>
+#include <ThreadPool.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <limits>
+#if defined(__AVX2__)
+#define RASTER_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define RASTER_SSE
+#include <emmintrin.h>
+#endif
 
-std::vector<CanvasPoint> getLine(CanvasPoint from, CanvasPoint to) {
-	std::vector<CanvasPoint> result;
-	if ((from.x == to.x) && (from.y == to.y)) {
-		result = { from };
-	}
-	else {
-		float xDiff = to.x - from.x;
-		float yDiff = to.y - from.y;
-		int stepNum = std::max(abs(xDiff), abs(yDiff)) + 1;
-		result = interpolate(from, to, stepNum);
-	}
-	return result;
-}
+// Triangles are filled in square blocks of this many pixels a side. A row of a block is one AVX2 register.
+#define RASTER_BLOCK_SIZE 8
+// Camera space points closer to the camera than this are clipped away before projecting.
+#define RASTER_NEAR_PLANE 0.01f
+// Vertices projected further out than this are treated as covering nothing. Keeping them in range
+// lets the edge functions of a block an edge crosses fit in 32 bits.
+#define RASTER_GUARD_BAND (1 << 24)
+// rasterisedRender draws each tile of this many pixels a side into buffers of its own. It must be a
+// multiple of RASTER_BLOCK_SIZE.
+#define RASTER_TILE_SIZE 64
+// How many triangles each job sets up and bins.
+#define RASTER_SETUP_JOB_SIZE 4096
 
-CanvasPoint getCanvasIntersectionPoint(glm::vec3 vertexPos, DrawingWindow& window, Camera cam) {
-	glm::vec3 cameraSpaceVertex = cam.orientation * (vertexPos - cam.position);
+// Projects a point already in camera space.
+CanvasPoint projectCameraSpacePoint(glm::vec3 cameraSpaceVertex, DrawingWindow& window, const Camera& cam) {
 	cameraSpaceVertex.x *= window.scale;
 	cameraSpaceVertex.y *= window.scale;
 
@@ -30,11 +42,142 @@ CanvasPoint getCanvasIntersectionPoint(glm::vec3 vertexPos, DrawingWindow& windo
 	return CanvasPoint(u, v, cameraSpaceVertex.z);
 }
 
+CanvasPoint getCanvasIntersectionPoint(glm::vec3 vertexPos, DrawingWindow& window, Camera cam) {
+	return projectCameraSpacePoint(cam.orientation * (vertexPos - cam.position), window, cam);
+}
+
+// Culls the triangle if it faces away from the camera and cullBackFaces is set, clips it against the near plane and projects what
+// is left. The camera looks down -z, so the clip space w of a point is -z and the near plane is w = near.
+// Returns how many vertices the visible polygon has, 0 when nothing is on screen, 3, or 4 when the plane
+// cuts a corner off. The texture points of the polygon's vertices go in texturePoints. Whatever was culled
+// or clipped is counted in stats.
+int clipTriangle(const ModelTriangle& triangle, DrawingWindow& window, const Camera& cam, CanvasPoint polygon[4], glm::vec2 texturePoints[4], bool cullBackFaces, RasterStats& stats) {
+	if (cullBackFaces && glm::dot(triangle.normal, triangle.vertices[0].position - cam.position) > 0) {
+		stats.backFacing++;
+		return 0;
+	}
+	glm::vec3 vertices[3];
+	int inFront = 0;
+	for (int i = 0; i < 3; i++) {
+		vertices[i] = cam.orientation * (triangle.vertices[i].position - cam.position);
+		if (-vertices[i].z >= RASTER_NEAR_PLANE) inFront++;
+	}
+	if (inFront == 0) {
+		stats.outsideFrustum++;
+		return 0;
+	}
+
+	int count = 0;
+	for (int i = 0; i < 3; i++) {
+		glm::vec3 from = vertices[i];
+		glm::vec3 to = vertices[(i + 1) % 3];
+		bool fromInFront = -from.z >= RASTER_NEAR_PLANE;
+		bool toInFront = -to.z >= RASTER_NEAR_PLANE;
+		glm::vec2 fromTexture = triangle.vertices[i].texturePoint;
+		glm::vec2 toTexture = triangle.vertices[(i + 1) % 3].texturePoint;
+		if (fromInFront) {
+			texturePoints[count] = fromTexture;
+			polygon[count++] = projectCameraSpacePoint(from, window, cam);
+		}
+		if (fromInFront != toInFront) {
+			float t = (-RASTER_NEAR_PLANE - from.z) / (to.z - from.z);
+			texturePoints[count] = fromTexture + (toTexture - fromTexture) * t;
+			polygon[count++] = projectCameraSpacePoint(from + (to - from) * t, window, cam);
+		}
+	}
+
+	int minX = polygon[0].x, minY = polygon[0].y, maxX = polygon[0].x, maxY = polygon[0].y;
+	for (int i = 1; i < count; i++) {
+		minX = std::min(minX, polygon[i].x);
+		minY = std::min(minY, polygon[i].y);
+		maxX = std::max(maxX, polygon[i].x);
+		maxY = std::max(maxY, polygon[i].y);
+	}
+	if ((maxX < 0) || (maxY < 0) || (minX >= window.width) || (minY >= window.height)) {
+		stats.outsideFrustum++;
+		return 0;
+	}
+	if (inFront < 3) stats.clipped++;
+	return count;
+}
+
+// Bresenham's algorithm: steps one pixel at a time along the line's longer axis, keeping the other
+// coordinate as a whole part and an integer remainder so it rounds to the nearest pixel exactly. Only
+// the steps inside the window are walked, writing straight into its buffers, so a line running far off
+// screen costs no more than what is left of it. The depth is
+// interpolated along the line and tested the way setPixelColour tests it.
 void drawLine(CanvasPoint from, CanvasPoint to, Colour colour, DrawingWindow& window, bool useDepth = true) {
-	std::vector<CanvasPoint> line = getLine(from, to);
-	uint32_t c = colour.getPackedColour();
-	for (int i = 0; i < line.size(); i++) {
-		useDepth ? window.setPixelColour(line[i].x, line[i].y, line[i].depth, c) : window.setPixelColour(line[i].x, line[i].y, c);
+	uint32_t packed = colour.getPackedColour();
+	uint32_t* pixels = window.getPixelBuffer();
+	float* depths = window.getDepthBuffer();
+	long long dx = (long long)to.x - (long long)from.x;
+	long long dy = (long long)to.y - (long long)from.y;
+	long long steps = std::max(std::abs(dx), std::abs(dy));
+	bool alongX = std::abs(dx) >= std::abs(dy);
+	long long majorStart = alongX ? from.x : from.y;
+	long long minorStart = alongX ? from.y : from.x;
+	long long majorDelta = alongX ? dx : dy;
+	long long minorDelta = alongX ? dy : dx;
+	long long majorSize = alongX ? window.width : window.height;
+	long long minorSize = alongX ? window.height : window.width;
+	int majorStep = majorDelta < 0 ? -1 : 1;
+
+	// The steps that keep each coordinate inside the window. The minor coordinate rounds to a pixel in
+	// the window between -0.5 and minorSize - 0.5, the range is widened a step and checked as it goes.
+	long long first = 0;
+	long long last = steps;
+	if (majorStep > 0) {
+		first = std::max(first, -majorStart);
+		last = std::min(last, majorSize - 1 - majorStart);
+	}
+	else {
+		first = std::max(first, majorStart - (majorSize - 1));
+		last = std::min(last, majorStart);
+	}
+	if (minorDelta != 0) {
+		double low = (-0.5 - minorStart) * steps / minorDelta;
+		double high = (minorSize - 0.5 - minorStart) * steps / minorDelta;
+		if (low > high) std::swap(low, high);
+		first = std::max(first, (long long)std::floor(low) - 1);
+		last = std::min(last, (long long)std::ceil(high) + 1);
+	}
+	if (first > last) return;
+
+	// At step i the minor coordinate is minorStart + (2 * i * minorDelta + steps) / (2 * steps), rounded down.
+	long long denominator = 2 * std::max(steps, 1LL);
+	long long numerator = (2 * first * minorDelta) + steps;
+	long long minor = minorStart + (numerator / denominator);
+	long long remainder = numerator % denominator;
+	if (remainder < 0) {
+		remainder += denominator;
+		minor--;
+	}
+	float depthStep = steps == 0 ? 0 : (to.depth - from.depth) / steps;
+	for (long long i = first; i <= last; i++) {
+		if (i != first) {
+			remainder += 2 * minorDelta;
+			if (remainder >= denominator) {
+				remainder -= denominator;
+				minor++;
+			}
+			else if (remainder < 0) {
+				remainder += denominator;
+				minor--;
+			}
+		}
+		if ((minor < 0) || (minor >= minorSize)) continue;
+		long long major = majorStart + (i * majorStep);
+		size_t pixel = alongX ? (minor * window.width) + major : (major * window.width) + minor;
+		if (!useDepth) {
+			pixels[pixel] = packed;
+			depths[pixel] = 0;
+			continue;
+		}
+		float depth = std::abs(from.depth + (depthStep * i));
+		if (depth > depths[pixel]) {
+			pixels[pixel] = packed;
+			depths[pixel] = depth;
+		}
 	}
 }
 
@@ -91,7 +234,7 @@ void drawFlatToppedTriangle(CanvasTriangle triangle, Colour colour, DrawingWindo
 }
 
 // Even though we use std::swap, this doesn't seem to sort triangle as a side effect.
-void drawFilledTriangle(CanvasTriangle triangle, Colour colour, DrawingWindow& window, bool useDepth = true) {
+void drawFilledTriangle(CanvasTriangle triangle, Colour colour, DrawingWindow& window, bool useDepth) {
 	// Vertices are sorted in ascending y order.
 	if (triangle.v0().y > triangle.v1().y) std::swap(triangle.v0(), triangle.v1());
 	if (triangle.v1().y > triangle.v2().y) std::swap(triangle.v1(), triangle.v2());
@@ -112,85 +255,660 @@ void drawFilledTriangle(CanvasTriangle triangle, Colour colour, DrawingWindow& w
 	}
 }
 
-// NEED TO REWRITE THIS TO USE GOOD FILLED TRIANGLE DRAWING
-//void drawTexturedTriangle(CanvasTriangle triangle, TextureMap texture, DrawingWindow& window) {
-//	// Vertices are sorted such that v0 has the lowest y value, meaning it's the highest.
-//	if (triangle.v0().y > triangle.v1().y) std::swap(triangle.v0(), triangle.v1());
-//	if (triangle.v1().y > triangle.v2().y) std::swap(triangle.v1(), triangle.v2());
-//	if (triangle.v0().y > triangle.v1().y) std::swap(triangle.v0(), triangle.v1());
-//
-//	std::vector<CanvasPoint> topToMiddle = getLine(triangle.v0(), triangle.v1());
-//	std::vector<CanvasPoint> middleToBottom = getLine(triangle.v1(), triangle.v2());
-//	std::vector<CanvasPoint> topToBottom = getLine(triangle.v0(), triangle.v2());
-//
-//	CanvasPoint middle;
-//	for (int i = 0; i < topToBottom.size(); i++) {
-//		if (topToBottom[i].y == triangle.v1().y) middle = topToBottom[i];
-//	}
-//
-//	for (int i = triangle.v0().y; i < middle.y; i++) {
-//
-//		CanvasPoint point1;
-//		for (int j = 0; j < topToMiddle.size(); j++) {
-//			if (topToMiddle[j].y == i) point1 = topToMiddle[j];
-//		}
-//		CanvasPoint point2;
-//		for (int j = 0; j < topToBottom.size(); j++) {
-//			if (topToBottom[j].y == i) point2 = topToBottom[j];
-//		}
-//
-//		std::vector<CanvasPoint> line = getLine(point1, point2);
-//		for (int j = 0; j < line.size(); j++) {
-//			int textureIndex = (line[j].texturePoint.y * texture.width) + line[j].texturePoint.x;
-//			window.setPixelColour(line[j].x, line[j].y, texture.pixels[textureIndex]);
-//		}
-//	}
-//	for (int i = middle.y; i <= triangle.v2().y; i++) {
-//
-//		CanvasPoint point1;
-//		for (int j = 0; j < middleToBottom.size(); j++) {
-//			if (middleToBottom[j].y == i) point1 = middleToBottom[j];
-//		}
-//		CanvasPoint point2;
-//		for (int j = 0; j < topToBottom.size(); j++) {
-//			if (topToBottom[j].y == i) point2 = topToBottom[j];
-//		}
-//
-//		std::vector<CanvasPoint> line = getLine(point1, point2);
-//		for (int j = 0; j < line.size(); j++) {
-//			int textureIndex = (line[j].texturePoint.y * texture.width) + line[j].texturePoint.x;
-//			window.setPixelColour(line[j].x, line[j].y, texture.pixels[textureIndex]);
-//		}
-//	}
-//}
-
-void pointcloudRender(std::vector<ModelTriangle> model, DrawingWindow& window, Camera cam) {
+// The triangle as three edge functions, each a*x + b*y + c, which are at least zero for the pixels it covers.
+struct TriangleEdgeFunctions {
+	long long a[3];
+	long long b[3];
+	long long c[3];
+	// The inverse depth across the screen, as a plane, and its largest value at any vertex. Depths worked out
+	// from the plane in floats can be off by up to depthError, which nearestDepth already allows for.
+	float depthX;
+	float depthY;
+	float depthOrigin;
+	float depthError;
+	float nearestDepth;
+	// The bounding box of the vertices.
+	int minX, minY, maxX, maxY;
+};
+
+// Pixels are sampled at their integer coordinates, the same grid the vertices are snapped to, so every
+// edge function is exact. A pixel exactly on an edge belongs to the triangle only if the edge is a top or
+// a left one, so triangles sharing an edge never both draw it. Returns false for triangles covering nothing.
+bool setupEdgeFunctions(const CanvasTriangle& triangle, TriangleEdgeFunctions& edges) {
+	long long x[3], y[3];
+	for (int i = 0; i < 3; i++) {
+		const CanvasPoint& vertex = triangle.vertices[i];
+		if ((std::abs(vertex.x) > RASTER_GUARD_BAND) || (std::abs(vertex.y) > RASTER_GUARD_BAND)) return false;
+		x[i] = vertex.x;
+		y[i] = vertex.y;
+	}
+	long long area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0) return false;
+	// Wind the vertices so the inside is positive; order is the vertex each edge starts from.
+	int order[3] = { 0, 1, 2 };
+	if (area < 0) {
+		std::swap(order[1], order[2]);
+		area = -area;
+	}
+	// The window compares inverse depths by their size, so they are kept positive.
+	double depth[3];
+	for (int i = 0; i < 3; i++) depth[i] = 1.0 / std::abs(triangle.vertices[order[i]].depth);
+	double depthX = 0, depthY = 0, depthOrigin = 0;
+	for (int i = 0; i < 3; i++) {
+		int from = order[i];
+		int to = order[(i + 1) % 3];
+		long long dx = x[to] - x[from];
+		long long dy = y[to] - y[from];
+		edges.a[i] = -dy;
+		edges.b[i] = dx;
+		edges.c[i] = dy * x[from] - dx * y[from];
+		// The edge function is zero along this edge, so it weights the vertex opposite it.
+		double weight = depth[(i + 2) % 3] / area;
+		depthX += edges.a[i] * weight;
+		depthY += edges.b[i] * weight;
+		depthOrigin += edges.c[i] * weight;
+		bool topLeft = (dy < 0) || ((dy == 0) && (dx > 0));
+		if (!topLeft) edges.c[i] -= 1;
+	}
+	edges.depthX = depthX;
+	edges.depthY = depthY;
+	edges.depthOrigin = depthOrigin;
+	edges.minX = std::min({ x[0], x[1], x[2] });
+	edges.minY = std::min({ y[0], y[1], y[2] });
+	edges.maxX = std::max({ x[0], x[1], x[2] });
+	edges.maxY = std::max({ y[0], y[1], y[2] });
+	// A handful of float roundings, each relative to the largest term summed.
+	double largestX = std::max(std::abs(edges.minX), std::abs(edges.maxX)) + RASTER_BLOCK_SIZE;
+	double largestY = std::max(std::abs(edges.minY), std::abs(edges.maxY)) + RASTER_BLOCK_SIZE;
+	edges.depthError = 1e-5 * (std::abs(depthOrigin) + std::abs(depthX) * largestX + std::abs(depthY) * largestY);
+	edges.nearestDepth = std::max({ depth[0], depth[1], depth[2] }) + edges.depthError;
+	return true;
+}
+
+bool triangleCoversPixel(const CanvasTriangle& triangle, int x, int y) {
+	TriangleEdgeFunctions edges;
+	if (!setupEdgeFunctions(triangle, edges)) return false;
+	for (int i = 0; i < 3; i++) {
+		if (edges.a[i] * x + edges.b[i] * y + edges.c[i] < 0) return false;
+	}
+	return true;
+}
+
+// Writes the rows of blocks straight into the window.
+struct WindowRows {
+	DrawingWindow& window;
+	uint32_t colour;
+	bool useDepth;
+
+	// Draws the pixels of one row of a block picked out by the bits of coverage.
+	void operator()(int x, int y, unsigned int coverage, float depth, float depthX) {
+		for (int lane = 0; coverage >> lane != 0; lane++) {
+			if ((coverage & (1u << lane)) == 0) continue;
+			if (useDepth) window.setPixelColour(x + lane, y, depth + depthX * lane, colour);
+			else window.setPixelColour(x + lane, y, colour);
+		}
+	}
+
+	void fillBlock(int x, int y, int rows, int columns, float depth, float depthX, float depthY) {
+		for (int row = 0; row < rows; row++) (*this)(x, y + row, (1u << columns) - 1, depth + depthY * row, depthX);
+	}
+
+	// The window only has a depth per pixel, so there is nothing to test whole blocks against.
+	bool isHidden(int blockX, int blockY, float nearestDepth) { return false; }
+	void finishBlock(int blockX, int blockY) {}
+};
+
+// Walks the pixels from (minX, minY) to (maxX, maxY) in RASTER_BLOCK_SIZE square blocks, stepping the edge
+// functions from block to block. minX and minY must be on block boundaries. A block entirely outside one
+// edge is skipped, and one entirely inside all three is passed on without testing its pixels. Only blocks
+// an edge passes through test each pixel, a row at a time. Rows go to drawRow as a mask of covered pixels,
+// and blocks the triangle covers completely go to drawRow.fillBlock.
+// Before a block is drawn drawRow.isHidden is asked whether anything the triangle could draw there would
+// be in front of what is already there, and drawRow.finishBlock is told once it has been drawn.
+template <typename RowWriter>
+void rasteriseBlocks(const TriangleEdgeFunctions& edges, int minX, int minY, int maxX, int maxY, RowWriter& drawRow) {
+	const int last = RASTER_BLOCK_SIZE - 1;
+	// How far each edge function can rise or fall from a block's top left pixel to its other pixels.
+	long long rise[3], fall[3];
+	for (int i = 0; i < 3; i++) {
+		rise[i] = (std::max(edges.a[i], 0LL) + std::max(edges.b[i], 0LL)) * last;
+		fall[i] = (std::min(edges.a[i], 0LL) + std::min(edges.b[i], 0LL)) * last;
+	}
+#if defined(RASTER_AVX2)
+	__m256i laneIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+#endif
+
+	long long rowStart[3];
+	for (int i = 0; i < 3; i++) rowStart[i] = edges.a[i] * minX + edges.b[i] * minY + edges.c[i];
+	for (int blockY = minY; blockY <= maxY; blockY += RASTER_BLOCK_SIZE) {
+		long long value[3] = { rowStart[0], rowStart[1], rowStart[2] };
+		int rows = std::min(RASTER_BLOCK_SIZE, maxY + 1 - blockY);
+		for (int blockX = minX; blockX <= maxX; blockX += RASTER_BLOCK_SIZE) {
+			int columns = std::min(RASTER_BLOCK_SIZE, maxX + 1 - blockX);
+			unsigned int columnMask = (1u << columns) - 1;
+			bool outside = false;
+			int crossing = 0;
+			for (int i = 0; i < 3; i++) {
+				if (value[i] + rise[i] < 0) outside = true;
+				else if (value[i] + fall[i] < 0) crossing |= 1 << i;
+			}
+			float depth = edges.depthOrigin + edges.depthX * blockX + edges.depthY * blockY;
+			float nearest = depth + (std::max(edges.depthX, 0.0f) + std::max(edges.depthY, 0.0f)) * last + edges.depthError;
+			if (outside || drawRow.isHidden(blockX, blockY, nearest)) {}
+			else if (crossing == 0) {
+				drawRow.fillBlock(blockX, blockY, rows, columns, depth, edges.depthX, edges.depthY);
+			}
+			else {
+				// Each crossing edge goes through this block, so its values here are small enough for 32 bits.
+				// Edges the whole block is inside of are left at zero, which always passes.
+				int start[3] = { 0, 0, 0 };
+				int stepX[3] = { 0, 0, 0 };
+				int stepY[3] = { 0, 0, 0 };
+				for (int i = 0; i < 3; i++) {
+					if (crossing & (1 << i)) {
+						start[i] = value[i];
+						stepX[i] = edges.a[i];
+						stepY[i] = edges.b[i];
+					}
+				}
+#if defined(RASTER_AVX2)
+				__m256i rowValues[3], stepValues[3];
+				for (int i = 0; i < 3; i++) {
+					rowValues[i] = _mm256_add_epi32(_mm256_set1_epi32(start[i]), _mm256_mullo_epi32(_mm256_set1_epi32(stepX[i]), laneIndices));
+					stepValues[i] = _mm256_set1_epi32(stepY[i]);
+				}
+#elif defined(RASTER_SSE)
+				// SSE2 has no 32 bit multiply, so the lanes are built by adding the step up.
+				__m128i rowValues[3][2], stepValues[3];
+				for (int i = 0; i < 3; i++) {
+					__m128i step = _mm_set1_epi32(stepX[i]);
+					__m128i twice = _mm_add_epi32(step, step);
+					__m128i lanes = _mm_add_epi32(_mm_set1_epi32(start[i]), _mm_and_si128(step, _mm_setr_epi32(0, -1, 0, -1)));
+					lanes = _mm_add_epi32(lanes, _mm_and_si128(twice, _mm_setr_epi32(0, 0, -1, -1)));
+					rowValues[i][0] = lanes;
+					rowValues[i][1] = _mm_add_epi32(lanes, _mm_add_epi32(twice, twice));
+					stepValues[i] = _mm_set1_epi32(stepY[i]);
+				}
+#endif
+				for (int row = 0; row < rows; row++) {
+#if defined(RASTER_AVX2)
+					__m256i signs = _mm256_or_si256(_mm256_or_si256(rowValues[0], rowValues[1]), rowValues[2]);
+					unsigned int coverage = ~_mm256_movemask_ps(_mm256_castsi256_ps(signs)) & columnMask;
+					for (int i = 0; i < 3; i++) rowValues[i] = _mm256_add_epi32(rowValues[i], stepValues[i]);
+#elif defined(RASTER_SSE)
+					__m128i low = _mm_or_si128(_mm_or_si128(rowValues[0][0], rowValues[1][0]), rowValues[2][0]);
+					__m128i high = _mm_or_si128(_mm_or_si128(rowValues[0][1], rowValues[1][1]), rowValues[2][1]);
+					unsigned int signs = _mm_movemask_ps(_mm_castsi128_ps(low)) | (_mm_movemask_ps(_mm_castsi128_ps(high)) << 4);
+					unsigned int coverage = ~signs & columnMask;
+					for (int i = 0; i < 3; i++) {
+						rowValues[i][0] = _mm_add_epi32(rowValues[i][0], stepValues[i]);
+						rowValues[i][1] = _mm_add_epi32(rowValues[i][1], stepValues[i]);
+					}
+#else
+					unsigned int coverage = 0;
+					for (int lane = 0; lane < columns; lane++) {
+						bool inside = true;
+						for (int i = 0; i < 3; i++) {
+							if (start[i] + stepX[i] * lane < 0) inside = false;
+						}
+						if (inside) coverage |= 1u << lane;
+					}
+					for (int i = 0; i < 3; i++) start[i] += stepY[i];
+#endif
+					if (coverage != 0) drawRow(blockX, blockY + row, coverage, depth + edges.depthY * row, edges.depthX);
+				}
+			}
+			if (!outside) drawRow.finishBlock(blockX, blockY);
+			for (int i = 0; i < 3; i++) value[i] += edges.a[i] * RASTER_BLOCK_SIZE;
+		}
+		for (int i = 0; i < 3; i++) rowStart[i] += edges.b[i] * RASTER_BLOCK_SIZE;
+	}
+}
+
+void fillTriangle(const CanvasTriangle& triangle, Colour colour, DrawingWindow& window, bool useDepth) {
+	TriangleEdgeFunctions edges;
+	if (!setupEdgeFunctions(triangle, edges)) return;
+	int minX = std::max(edges.minX, 0) & ~(RASTER_BLOCK_SIZE - 1);
+	int minY = std::max(edges.minY, 0) & ~(RASTER_BLOCK_SIZE - 1);
+	int maxX = std::min(edges.maxX, window.width - 1);
+	int maxY = std::min(edges.maxY, window.height - 1);
+	if ((minX > maxX) || (minY > maxY)) return;
+	WindowRows rows = { window, colour.getPackedColour(), useDepth };
+	rasteriseBlocks(edges, minX, minY, maxX, maxY, rows);
+}
+
+// Projects the vertices straight into the window's pixels. Points behind the near plane or off the window
+// are dropped before anything is written.
+void pointcloudRender(const SceneView& scene, DrawingWindow& window) {
 	uint32_t white = (255 << 24) + (255 << 16) + (255 << 8) + 255;
+	uint32_t* pixels = window.getPixelBuffer();
+	float* depths = window.getDepthBuffer();
+	const Camera& cam = scene.cam;
 
-	for (int i = 0; i < model.size(); i++) { // For each triangle in the model...
+	for (int i = 0; i < scene.getTriangleCount(); i++) { // For each triangle in the model...
+		ModelTriangle modelTriangle = scene.getTriangle(i);
 		for (int j = 0; j < 3; j++) { // For each vertex in the triangle...
-			CanvasPoint point = getCanvasIntersectionPoint(model[i].vertices[j].position, window, cam); // Get intersection point...
-			window.setPixelColour(point.x, point.y, white); // Set colour
+			glm::vec3 point = cam.orientation * (modelTriangle.vertices[j].position - cam.position);
+			if (-point.z < RASTER_NEAR_PLANE) continue;
+			// The same sums as projectCameraSpacePoint, so the points land where they always have.
+			int x = (window.width / 2) - (cam.focalLength * ((point.x * window.scale) / point.z));
+			int y = (window.height / 2) + (cam.focalLength * ((point.y * window.scale) / point.z));
+			if ((x < 0) || (y < 0) || (x >= window.width) || (y >= window.height)) continue;
+			pixels[(y * window.width) + x] = white;
+			depths[(y * window.width) + x] = 0;
+		}
+	}
+}
+
+void wireframeRender(const SceneView& scene, DrawingWindow& window) {
+	RasterStats stats = {};
+	for (int i = 0; i < scene.getTriangleCount(); i++) { // For each triangle in the model...
+		CanvasPoint polygon[4];
+		glm::vec2 texturePoints[4];
+		int count = clipTriangle(scene.getTriangle(i), window, scene.cam, polygon, texturePoints, true, stats);
+		for (int j = 0; j < count; j++) drawLine(polygon[j], polygon[(j + 1) % count], Colour(255, 255, 255), window);
+	}
+}
+
+#define RASTER_TILE_BLOCKS (RASTER_TILE_SIZE / RASTER_BLOCK_SIZE)
+
+// A texture mapped across a triangle. The texture point divided by the depth varies linearly across the
+// screen, as the inverse depth does, so u/w and v/w are kept as planes and each pixel divides them by its
+// inverse depth to get a perspective correct texture point. pixels is null for triangles with no texture.
+struct TexturePlanes {
+	const uint32_t* pixels;
+	int width;
+	int height;
+	float uX, uY, uOrigin;
+	float vX, vY, vOrigin;
+};
+
+// The plane through the values at the triangle's vertices, as valueX * x + valueY * y + origin.
+void setupPlane(const CanvasTriangle& triangle, const double values[3], float& valueX, float& valueY, float& origin) {
+	double x[3], y[3];
+	for (int i = 0; i < 3; i++) {
+		x[i] = triangle.vertices[i].x;
+		y[i] = triangle.vertices[i].y;
+	}
+	double area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	double gradientX = ((values[1] - values[0]) * (y[2] - y[0]) - (values[2] - values[0]) * (y[1] - y[0])) / area;
+	double gradientY = ((values[2] - values[0]) * (x[1] - x[0]) - (values[1] - values[0]) * (x[2] - x[0])) / area;
+	valueX = gradientX;
+	valueY = gradientY;
+	origin = values[0] - gradientX * x[0] - gradientY * y[0];
+}
+
+// Only called for triangles setupEdgeFunctions accepted, so the triangle has some area.
+void setupTexturePlanes(const CanvasTriangle& triangle, const glm::vec2 texturePoints[3], const TextureMap* texture, TexturePlanes& planes) {
+	planes.pixels = nullptr;
+	if ((texture == nullptr) || texture->pixels.empty()) return;
+	planes.pixels = texture->pixels.data();
+	planes.width = texture->width;
+	planes.height = texture->height;
+	double u[3], v[3];
+	for (int i = 0; i < 3; i++) {
+		double inverseDepth = 1.0 / std::abs(triangle.vertices[i].depth);
+		u[i] = texturePoints[i].x * inverseDepth;
+		v[i] = texturePoints[i].y * inverseDepth;
+	}
+	setupPlane(triangle, u, planes.uX, planes.uY, planes.uOrigin);
+	setupPlane(triangle, v, planes.vX, planes.vY, planes.vOrigin);
+}
+
+// The nearest texel, wrapping round the edges, as TextureMap::GetValue picks it.
+uint32_t sampleTexture(const TexturePlanes& planes, float u, float v) {
+	int x = std::floor((u * planes.width) + 0.5f);
+	int y = std::floor((v * planes.height) + 0.5f);
+	if ((x < 0) || (x >= planes.width)) x = ((x % planes.width) + planes.width) % planes.width;
+	if ((y < 0) || (y >= planes.height)) y = ((y % planes.height) + planes.height) % planes.height;
+	return planes.pixels[(y * planes.width) + x];
+}
+
+// A tile's own colour and depth buffers. On top of the depths it keeps the farthest depth in each block
+// and in the whole tile, as the smallest inverse depth, which is zero while any pixel is still empty.
+// Anything farther than that is hidden, so whole triangles and blocks can be skipped. A block's farthest
+// depth only needs working out again once it has no empty pixels and its farthest pixel is drawn over.
+// The nearest depth in each block is kept too, anything entirely nearer than it needs no depth tests.
+struct RasterTile {
+	uint32_t colours[RASTER_TILE_SIZE * RASTER_TILE_SIZE];
+	float depths[RASTER_TILE_SIZE * RASTER_TILE_SIZE];
+	float farthestInBlock[RASTER_TILE_BLOCKS * RASTER_TILE_BLOCKS];
+	float nearestInBlock[RASTER_TILE_BLOCKS * RASTER_TILE_BLOCKS];
+	int emptyInBlock[RASTER_TILE_BLOCKS * RASTER_TILE_BLOCKS];
+	float farthest;
+};
+
+// Writes the rows of blocks into a tile's buffers, skipping blocks its depths show are hidden. Pixels
+// are coloured from texture when there is one, stepping u/w and v/w along the row, and colour otherwise.
+struct TileRows {
+	RasterTile& tile;
+	RasterStats& stats;
+	int tileX;
+	int tileY;
+	uint32_t colour;
+	const TexturePlanes* texture;
+	float depthError;
+	bool drewOverFarthest;
+
+	int getBlock(int x, int y) {
+		return (((y - tileY) / RASTER_BLOCK_SIZE) * RASTER_TILE_BLOCKS) + ((x - tileX) / RASTER_BLOCK_SIZE);
+	}
+
+	void operator()(int x, int y, unsigned int coverage, float depth, float depthX) {
+		int rowStart = ((y - tileY) * RASTER_TILE_SIZE) + (x - tileX);
+		int block = getBlock(x, y);
+		float u = 0, v = 0;
+		if (texture != nullptr) {
+			u = texture->uOrigin + texture->uX * x + texture->uY * y;
+			v = texture->vOrigin + texture->vX * x + texture->vY * y;
+		}
+		for (int lane = 0; coverage >> lane != 0; lane++) {
+			if ((coverage & (1u << lane)) == 0) continue;
+			float pixelDepth = depth + depthX * lane;
+			float previous = tile.depths[rowStart + lane];
+			stats.depthTestedFragments++;
+			if (pixelDepth > previous) {
+				tile.depths[rowStart + lane] = pixelDepth;
+				tile.colours[rowStart + lane] = texture != nullptr ? getTexel(u, v, lane, pixelDepth) : colour;
+				stats.shadedFragments++;
+				if (previous == 0) tile.emptyInBlock[block]--;
+				if (previous <= tile.farthestInBlock[block]) drewOverFarthest = true;
+				tile.nearestInBlock[block] = std::max(tile.nearestInBlock[block], pixelDepth);
+			}
+		}
+	}
+
+	// A whole block in front of everything in it is written without testing any depths. Its farthest and
+	// nearest depths are those of its corners, widened by the rounding the rows' depths could have.
+	void fillBlock(int x, int y, int rows, int columns, float depth, float depthX, float depthY) {
+		int block = getBlock(x, y);
+		float farthestRow = depth + depthY * (depthY < 0 ? rows - 1 : 0);
+		float farthest = farthestRow + depthX * (depthX < 0 ? columns - 1 : 0) - depthError;
+		if ((rows != RASTER_BLOCK_SIZE) || (columns != RASTER_BLOCK_SIZE) || (farthest <= tile.nearestInBlock[block])) {
+			for (int row = 0; row < rows; row++) (*this)(x, y + row, (1u << columns) - 1, depth + depthY * row, depthX);
+			return;
+		}
+		for (int row = 0; row < RASTER_BLOCK_SIZE; row++) {
+			float rowDepth = depth + depthY * row;
+			int rowStart = ((y + row - tileY) * RASTER_TILE_SIZE) + (x - tileX);
+			for (int lane = 0; lane < RASTER_BLOCK_SIZE; lane++) tile.depths[rowStart + lane] = rowDepth + depthX * lane;
+			if (texture == nullptr) {
+				for (int lane = 0; lane < RASTER_BLOCK_SIZE; lane++) tile.colours[rowStart + lane] = colour;
+				continue;
+			}
+			float u = texture->uOrigin + texture->uX * x + texture->uY * (y + row);
+			float v = texture->vOrigin + texture->vX * x + texture->vY * (y + row);
+			for (int lane = 0; lane < RASTER_BLOCK_SIZE; lane++) tile.colours[rowStart + lane] = getTexel(u, v, lane, tile.depths[rowStart + lane]);
+		}
+		float nearestRow = depth + depthY * (depthY > 0 ? RASTER_BLOCK_SIZE - 1 : 0);
+		tile.nearestInBlock[block] = nearestRow + depthX * (depthX > 0 ? RASTER_BLOCK_SIZE - 1 : 0) + depthError;
+		stats.depthTestedFragments += RASTER_BLOCK_SIZE * RASTER_BLOCK_SIZE;
+		stats.shadedFragments += RASTER_BLOCK_SIZE * RASTER_BLOCK_SIZE;
+		tile.emptyInBlock[block] = 0;
+		setFarthest(block, farthest);
+	}
+
+	// The texel for the pixel lane places along a row starting with u/w and v/w.
+	uint32_t getTexel(float u, float v, int lane, float pixelDepth) {
+		float w = 1 / pixelDepth;
+		return sampleTexture(*texture, (u + texture->uX * lane) * w, (v + texture->vX * lane) * w);
+	}
+
+	bool isHidden(int blockX, int blockY, float nearestDepth) {
+		if (nearestDepth >= tile.farthestInBlock[getBlock(blockX, blockY)]) return false;
+		stats.hiddenBlocks++;
+		return true;
+	}
+
+	// Brings the block's farthest depth up to date, and the tile's if the block was the farthest.
+	void finishBlock(int blockX, int blockY) {
+		int block = getBlock(blockX, blockY);
+		bool changed = drewOverFarthest && (tile.emptyInBlock[block] == 0);
+		drewOverFarthest = false;
+		if (!changed) return;
+		const float* depths = &tile.depths[((blockY - tileY) * RASTER_TILE_SIZE) + (blockX - tileX)];
+		float farthest = depths[0];
+		for (int y = 0; y < RASTER_BLOCK_SIZE; y++) {
+			for (int x = 0; x < RASTER_BLOCK_SIZE; x++) farthest = std::min(farthest, depths[(y * RASTER_TILE_SIZE) + x]);
 		}
+		setFarthest(block, farthest);
 	}
+
+	void setFarthest(int block, float farthest) {
+		float previous = tile.farthestInBlock[block];
+		tile.farthestInBlock[block] = farthest;
+		if (previous == tile.farthest) {
+			tile.farthest = *std::min_element(tile.farthestInBlock, tile.farthestInBlock + (RASTER_TILE_BLOCKS * RASTER_TILE_BLOCKS));
+		}
+	}
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 }
 
-void wireframeRender(std::vector<ModelTriangle> model, DrawingWindow& window, Camera cam) {
-	for (int i = 0; i < model.size(); i++) { // For each triangle in the model...
-		CanvasPoint va = getCanvasIntersectionPoint(model[i].vertices[0].position, window, cam);
-		CanvasPoint vb = getCanvasIntersectionPoint(model[i].vertices[1].position, window, cam);
-		CanvasPoint vc = getCanvasIntersectionPoint(model[i].vertices[2].position, window, cam);
-		CanvasTriangle triangle = CanvasTriangle(va, vb, vc);
-		drawStrokedTriangle(triangle, Colour(255, 255, 255), window);
+// Sets up a triangle for rasterisedRender, with its bounding box cut down to the window. Returns false,
+// leaving the box empty, when it covers nothing.
+bool setupScreenTriangle(const CanvasTriangle& triangle, DrawingWindow& window, TriangleEdgeFunctions& edges) {
+	bool covers = setupEdgeFunctions(triangle, edges);
+	edges.minX = std::max(edges.minX, 0);
+	edges.minY = std::max(edges.minY, 0);
+	edges.maxX = std::min(edges.maxX, window.width - 1);
+	edges.maxY = std::min(edges.maxY, window.height - 1);
+	if (!covers || (edges.minX > edges.maxX) || (edges.minY > edges.maxY)) {
+		edges.minX = 0;
+		edges.maxX = -1;
+		return false;
 	}
+	return true;
 }
 
-void rasterisedRender(std::vector<ModelTriangle> model, DrawingWindow& window, Camera cam) {
-	for (int i = 0; i < model.size(); i++) { // For each triangle in the model...
-		CanvasPoint va = getCanvasIntersectionPoint(model[i].vertices[0].position, window, cam);
-		CanvasPoint vb = getCanvasIntersectionPoint(model[i].vertices[1].position, window, cam);
-		CanvasPoint vc = getCanvasIntersectionPoint(model[i].vertices[2].position, window, cam);
-		CanvasTriangle triangle = CanvasTriangle(va, vb, vc);
-		drawFilledTriangle(triangle, model[i].GetColour(model, {}, cam, HARD, 0, glm::vec3(0,0,0)), window);
+// Adds one to the count of every tile the triangle's bounding box overlaps.
+void countTiles(const TriangleEdgeFunctions& edges, int tilesAcross, int* counts) {
+	for (int tileY = edges.minY / RASTER_TILE_SIZE; tileY <= edges.maxY / RASTER_TILE_SIZE; tileY++) {
+		for (int tileX = edges.minX / RASTER_TILE_SIZE; tileX <= edges.maxX / RASTER_TILE_SIZE; tileX++) counts[(tileY * tilesAcross) + tileX]++;
+	}
+}
+
+// Writes the triangle's index into the next free place of every tile countTiles counted it in.
+void binTiles(const TriangleEdgeFunctions& edges, int index, int tilesAcross, int* offsets, std::vector<int>& bins) {
+	if (edges.minX > edges.maxX) return;
+	for (int tileY = edges.minY / RASTER_TILE_SIZE; tileY <= edges.maxY / RASTER_TILE_SIZE; tileY++) {
+		for (int tileX = edges.minX / RASTER_TILE_SIZE; tileX <= edges.maxX / RASTER_TILE_SIZE; tileX++) bins[offsets[(tileY * tilesAcross) + tileX]++] = index;
+	}
+}
+
+// Everything rasterisedRender and rasteriseGBuffer do but the writing out. Given a G-buffer each pixel
+// keeps the index of its triangle rather than a colour, and back faces are drawn too, as the ray tracer
+// the G-buffer stands in for sees them.
+RasterStats rasteriseTiles(const SceneView& scene, DrawingWindow& window, int threadCount, bool sortFrontToBack, GBuffer* gBuffer) {
+	RasterStats stats = {};
+	ThreadPool& pool = getThreadPool(threadCount);
+	int triangleCount = scene.getTriangleCount();
+	int tilesAcross = (window.width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+	int tilesDown = (window.height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+	int tileCount = tilesAcross * tilesDown;
+	int jobCount = (triangleCount + RASTER_SETUP_JOB_SIZE - 1) / RASTER_SETUP_JOB_SIZE;
+
+	// Set up every triangle and count how many of each job's triangles touch each tile. A triangle
+	// with nothing on screen is left with an empty bounding box so it lands in no tile. When the near
+	// plane cuts a corner off one, the second triangle of what is left goes in its job's list of extras.
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	// Left uninitialised, every entry is written by its job before anything reads it.
+	std::unique_ptr<TriangleEdgeFunctions[]> triangles(new TriangleEdgeFunctions[triangleCount]);
+	std::unique_ptr<uint32_t[]> colours(new uint32_t[triangleCount]);
+	std::unique_ptr<TexturePlanes[]> textures(new TexturePlanes[triangleCount]);
+	std::vector<std::vector<TriangleEdgeFunctions>> extraTriangles(jobCount);
+	std::vector<std::vector<TexturePlanes>> extraTextures(jobCount);
+	std::vector<std::vector<int>> extraSources(jobCount);
+	std::vector<RasterStats> jobStats(jobCount, RasterStats());
+	std::vector<int> binOffsets((size_t)jobCount * tileCount);
+	pool.run(jobCount, [&](int job, int threadIndex) {
+		int* counts = &binOffsets[(size_t)job * tileCount];
+		int end = std::min(triangleCount, (job + 1) * RASTER_SETUP_JOB_SIZE);
+		for (int i = job * RASTER_SETUP_JOB_SIZE; i < end; i++) {
+			ModelTriangle modelTriangle = scene.getTriangle(i);
+			CanvasPoint polygon[4];
+			glm::vec2 texturePoints[4];
+			int vertexCount = clipTriangle(modelTriangle, window, scene.cam, polygon, texturePoints, gBuffer == nullptr, jobStats[job]);
+			TriangleEdgeFunctions& edges = triangles[i];
+			edges.minX = 0;
+			edges.maxX = -1;
+			CanvasTriangle first = CanvasTriangle(polygon[0], polygon[1], polygon[2]);
+			bool covers = (vertexCount != 0) && setupScreenTriangle(first, window, edges);
+			if (covers) countTiles(edges, tilesAcross, counts);
+			const TextureMap* texture = (gBuffer == nullptr) && (covers || (vertexCount == 4)) ? modelTriangle.material->GetTexture() : nullptr;
+			if (covers) setupTexturePlanes(first, texturePoints, texture, textures[i]);
+			if (vertexCount == 4) {
+				TriangleEdgeFunctions extra;
+				CanvasTriangle second = CanvasTriangle(polygon[0], polygon[2], polygon[3]);
+				if (setupScreenTriangle(second, window, extra)) {
+					glm::vec2 secondTexturePoints[3] = { texturePoints[0], texturePoints[2], texturePoints[3] };
+					TexturePlanes extraTexture;
+					setupTexturePlanes(second, secondTexturePoints, texture, extraTexture);
+					extraTriangles[job].push_back(extra);
+					extraTextures[job].push_back(extraTexture);
+					extraSources[job].push_back(i);
+					countTiles(extra, tilesAcross, counts);
+					covers = true;
+				}
+			}
+			if (covers) colours[i] = gBuffer != nullptr ? i : modelTriangle.GetColour(scene, HARD, RayTriangleIntersection(modelTriangle.vertices[0].position, 0, i)).getPackedColour();
+		}
+	});
+	for (int job = 0; job < jobCount; job++) {
+		stats.backFacing += jobStats[job].backFacing;
+		stats.outsideFrustum += jobStats[job].outsideFrustum;
+		stats.clipped += jobStats[job].clipped;
+	}
+	stats.setupSeconds = secondsSince(start);
+
+	// Lay the bins out one after another, each holding its triangles in job order, then have every
+	// job write its triangles into the places counted for it. Every bin keeps the model's draw order.
+	// Extras are numbered after the model's triangles.
+	start = std::chrono::steady_clock::now();
+	std::vector<int> binStarts(tileCount + 1);
+	long long binned = 0;
+	for (int tile = 0; tile < tileCount; tile++) {
+		binStarts[tile] = binned;
+		for (int job = 0; job < jobCount; job++) {
+			int count = binOffsets[((size_t)job * tileCount) + tile];
+			binOffsets[((size_t)job * tileCount) + tile] = binned;
+			binned += count;
+		}
 	}
+	binStarts[tileCount] = binned;
+	std::vector<int> firstExtras(jobCount + 1, triangleCount);
+	for (int job = 0; job < jobCount; job++) firstExtras[job + 1] = firstExtras[job] + extraTriangles[job].size();
+	std::vector<TriangleEdgeFunctions> extras;
+	std::vector<TexturePlanes> mergedExtraTextures;
+	std::vector<uint32_t> extraColours;
+	for (int job = 0; job < jobCount; job++) {
+		extras.insert(extras.end(), extraTriangles[job].begin(), extraTriangles[job].end());
+		mergedExtraTextures.insert(mergedExtraTextures.end(), extraTextures[job].begin(), extraTextures[job].end());
+		for (int k = 0; k < extraSources[job].size(); k++) extraColours.push_back(colours[extraSources[job][k]]);
+	}
+	std::vector<int> bins(binned);
+	pool.run(jobCount, [&](int job, int threadIndex) {
+		int* offsets = &binOffsets[(size_t)job * tileCount];
+		int end = std::min(triangleCount, (job + 1) * RASTER_SETUP_JOB_SIZE);
+		int extra = 0;
+		for (int i = job * RASTER_SETUP_JOB_SIZE; i < end; i++) {
+			binTiles(triangles[i], i, tilesAcross, offsets, bins);
+			if ((extra < extraSources[job].size()) && (extraSources[job][extra] == i)) {
+				binTiles(extraTriangles[job][extra], firstExtras[job] + extra, tilesAcross, offsets, bins);
+				extra++;
+			}
+		}
+	});
+	stats.binningSeconds = secondsSince(start);
+
+	// Each tile is drawn by one thread into its own buffers, which are small enough to stay in
+	// cache, and is only merged into the window once all of its triangles are done. A triangle whose
+	// nearest vertex is behind everything already in the tile is skipped without being rasterised.
+	// Pixels of the tile off the edge of the window start out infinitely near so they never hold it back.
+	start = std::chrono::steady_clock::now();
+	std::vector<RasterTile> tiles(pool.getThreadCount());
+	std::vector<RasterStats> threadStats(pool.getThreadCount(), RasterStats());
+	pool.run(tileCount, [&](int tileIndex, int threadIndex) {
+		if (binStarts[tileIndex] == binStarts[tileIndex + 1]) return;
+		RasterTile& tile = tiles[threadIndex];
+		RasterStats& tileStats = threadStats[threadIndex];
+		int tileX = (tileIndex % tilesAcross) * RASTER_TILE_SIZE;
+		int tileY = (tileIndex / tilesAcross) * RASTER_TILE_SIZE;
+		int tileWidth = std::min(RASTER_TILE_SIZE, window.width - tileX);
+		int tileHeight = std::min(RASTER_TILE_SIZE, window.height - tileY);
+		for (int y = 0; y < RASTER_TILE_SIZE; y++) {
+			for (int x = 0; x < RASTER_TILE_SIZE; x++) {
+				tile.depths[(y * RASTER_TILE_SIZE) + x] = ((x < tileWidth) && (y < tileHeight)) ? 0.0f : std::numeric_limits<float>::max();
+			}
+		}
+		for (int y = 0; y < RASTER_TILE_BLOCKS; y++) {
+			for (int x = 0; x < RASTER_TILE_BLOCKS; x++) {
+				int width = std::max(0, std::min(RASTER_BLOCK_SIZE, tileWidth - (x * RASTER_BLOCK_SIZE)));
+				int height = std::max(0, std::min(RASTER_BLOCK_SIZE, tileHeight - (y * RASTER_BLOCK_SIZE)));
+				tile.emptyInBlock[(y * RASTER_TILE_BLOCKS) + x] = width * height;
+				tile.farthestInBlock[(y * RASTER_TILE_BLOCKS) + x] = width * height != 0 ? 0.0f : std::numeric_limits<float>::max();
+				tile.nearestInBlock[(y * RASTER_TILE_BLOCKS) + x] = width * height != 0 ? 0.0f : std::numeric_limits<float>::max();
+			}
+		}
+		tile.farthest = 0;
+
+		int* first = &bins[binStarts[tileIndex]];
+		int* last = &bins[0] + binStarts[tileIndex + 1];
+		auto getTriangle = [&](int index) -> const TriangleEdgeFunctions& {
+			return index < triangleCount ? triangles[index] : extras[index - triangleCount];
+		};
+		if (sortFrontToBack) {
+			std::stable_sort(first, last, [&](int a, int b) { return getTriangle(a).nearestDepth > getTriangle(b).nearestDepth; });
+		}
+		for (int* b = first; b != last; b++) {
+			const TriangleEdgeFunctions& edges = getTriangle(*b);
+			if (edges.nearestDepth < tile.farthest) {
+				tileStats.hiddenTriangles++;
+				continue;
+			}
+			int minX = std::max(edges.minX, tileX) & ~(RASTER_BLOCK_SIZE - 1);
+			int minY = std::max(edges.minY, tileY) & ~(RASTER_BLOCK_SIZE - 1);
+			int maxX = std::min(edges.maxX, tileX + tileWidth - 1);
+			int maxY = std::min(edges.maxY, tileY + tileHeight - 1);
+			bool extra = *b >= triangleCount;
+			const TexturePlanes& texture = extra ? mergedExtraTextures[*b - triangleCount] : textures[*b];
+			TileRows rows = { tile, tileStats, tileX, tileY, extra ? extraColours[*b - triangleCount] : colours[*b],
+				texture.pixels != nullptr ? &texture : nullptr, edges.depthError, false };
+			rasteriseBlocks(edges, minX, minY, maxX, maxY, rows);
+		}
+		for (int y = 0; y < tileHeight; y++) {
+			for (int x = 0; x < tileWidth; x++) {
+				float depth = tile.depths[(y * RASTER_TILE_SIZE) + x];
+				if (depth > 0) tileStats.coveredPixels++;
+				if (gBuffer != nullptr) {
+					gBuffer->triangleIndices[((tileY + y) * window.width) + tileX + x] = depth > 0 ? tile.colours[(y * RASTER_TILE_SIZE) + x] : -1;
+				}
+				else if (depth > 0) window.setPixelColour(tileX + x, tileY + y, depth, tile.colours[(y * RASTER_TILE_SIZE) + x]);
+			}
+		}
+	});
+	for (int thread = 0; thread < threadStats.size(); thread++) {
+		stats.hiddenTriangles += threadStats[thread].hiddenTriangles;
+		stats.hiddenBlocks += threadStats[thread].hiddenBlocks;
+		stats.depthTestedFragments += threadStats[thread].depthTestedFragments;
+		stats.shadedFragments += threadStats[thread].shadedFragments;
+		stats.coveredPixels += threadStats[thread].coveredPixels;
+	}
+	stats.rasteriseSeconds = secondsSince(start);
+	stats.binnedTriangles = binned;
+	return stats;
+}
+
+RasterStats rasterisedRender(const SceneView& scene, DrawingWindow& window, int threadCount, bool sortFrontToBack) {
+	return rasteriseTiles(scene, window, threadCount, sortFrontToBack, nullptr);
+}
+
+RasterStats rasteriseGBuffer(const SceneView& scene, DrawingWindow& window, GBuffer& gBuffer, int threadCount) {
+	gBuffer.width = window.width;
+	gBuffer.height = window.height;
+	// Tiles no triangle reaches are skipped, so their pixels are cleared here.
+	gBuffer.triangleIndices.assign((size_t)window.width * window.height, -1);
+	return rasteriseTiles(scene, window, threadCount, false, &gBuffer);
 }
\ No newline at end of file
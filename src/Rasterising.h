@@ -4,7 +4,62 @@
 #include <DrawingWindow.h>
 #include <Objects.h>
 #include <ModelTriangle.h>
+#include <SceneView.h>
+#include <CanvasTriangle.h>
+#include <Colour.h>
 
-void pointcloudRender(std::vector<ModelTriangle> model, DrawingWindow& window, Camera cam);
-void wireframeRender(std::vector<ModelTriangle> model, DrawingWindow& window, Camera cam);
-void rasterisedRender(std::vector<ModelTriangle> model, DrawingWindow& window, Camera cam);
\ No newline at end of file
+// Projects a point in world space onto the window. The depth is the point's z in camera space.
+CanvasPoint getCanvasIntersectionPoint(glm::vec3 vertexPos, DrawingWindow& window, Camera cam);
+
+void pointcloudRender(const SceneView& scene, DrawingWindow& window);
+void wireframeRender(const SceneView& scene, DrawingWindow& window);
+// How long each phase of the last rasterised frame took, and how many times triangles were put in a
+// tile's bin. Also how many triangles were culled for facing away or being off screen, and how many
+// the near plane clipped.
+// Then how much the tiles' hierarchical depths saved: triangles skipped in a tile and blocks skipped
+// inside a triangle because everything there was already nearer. Of the pixels that were rasterised,
+// how many were depth tested and how many passed and were shaded, against the pixels that ended up
+// covered, so shadedFragments / coveredPixels is the overdraw.
+struct RasterStats {
+	double setupSeconds;
+	double binningSeconds;
+	double rasteriseSeconds;
+	long long binnedTriangles;
+	long long backFacing;
+	long long outsideFrustum;
+	long long clipped;
+	long long hiddenTriangles;
+	long long hiddenBlocks;
+	long long depthTestedFragments;
+	long long shadedFragments;
+	long long coveredPixels;
+};
+
+// Sets up the triangles and sorts them into bins by the screen tiles they overlap, spread over the
+// threads, then draws the tiles in parallel. Each bin keeps the model's order, so the image is the
+// same as drawing the triangles one by one with any number of threads. sortFrontToBack draws each
+// tile's triangles nearest first instead, so fewer are drawn only to be covered up; where two
+// triangles meet at exactly the same depth the other one may win. Triangles whose material has a
+// texture are drawn with it, perspective correct, and the rest in their material's flat colour.
+RasterStats rasterisedRender(const SceneView& scene, DrawingWindow& window, int threadCount = 1, bool sortFrontToBack = false);
+
+// The triangle seen at each pixel of a window, -1 where there is none. Where on the triangle the pixel
+// is, its barycentric coordinates and depth, is left to whoever shades it.
+struct GBuffer {
+	int width;
+	int height;
+	std::vector<int> triangleIndices;
+};
+
+// Rasterises the scene's triangle indices into gBuffer, sized to the window, the way rasterisedRender
+// draws their colours but keeping the triangles that face away from the camera.
+RasterStats rasteriseGBuffer(const SceneView& scene, DrawingWindow& window, GBuffer& gBuffer, int threadCount = 1);
+
+// Fills a triangle with edge functions over blocks of pixels. It allocates nothing.
+void fillTriangle(const CanvasTriangle& triangle, Colour colour, DrawingWindow& window, bool useDepth = true);
+
+// Fills a triangle by splitting it into flat topped and flat bottomed halves and drawing each row as a line.
+void drawFilledTriangle(CanvasTriangle triangle, Colour colour, DrawingWindow& window, bool useDepth = true);
+
+// Whether fillTriangle covers pixel (x, y), tested on its own. Slow, but a reference for the coverage.
+bool triangleCoversPixel(const CanvasTriangle& triangle, int x, int y);
\ No newline at end of file
@@ -2,152 +2,163 @@
 #include <Raytracing.h>
 #include <Utilities.h>
 #include <UniformColourMaterial.h>
+#include <ThreadPool.h>
+#include <VertexLightCache.h>
+#include <IrradianceCache.h>
+#include <FrameScene.h>
+#include <array>
 
 #define PI 3.14159265358979323846264338327950288
+#define TILE_SIZE 16
+#define SHADOW_BIAS 0.001f
 
-RayTriangleIntersection getIntersection(glm::vec3 startPosition, glm::vec3 direction, ModelTriangle target) {
-	RayTriangleIntersection result = RayTriangleIntersection(glm::vec3(0, 0, 0),
-		std::numeric_limits<float>::max(),
-		ModelTriangle(Vertex(), Vertex(), Vertex(),
-			&UniformColourMaterial(Colour(0, 0, 0)),
-			glm::vec3(0, 0, 0)),
-		0);
-
-	glm::vec3 e0 = target.vertices[1].position - target.vertices[0].position;
-	glm::vec3 e1 = target.vertices[2].position - target.vertices[0].position;
-	glm::vec3 SPVector = startPosition - target.vertices[0].position;
-	glm::mat3 DEMatrix(-direction, e0, e1);
-	glm::vec3 possibleSolution = glm::inverse(DEMatrix) * SPVector;
-
-	bool boundsCheck = ((possibleSolution.y >= 0.0) && (possibleSolution.y <= 1.0)) &&
-		((possibleSolution.z >= 0.0) && (possibleSolution.z <= 1.0)) &&
-		((possibleSolution.y + possibleSolution.z) <= 1.0);
-
-	if ((possibleSolution.x > 0) && boundsCheck) {
-		result = RayTriangleIntersection(direction * possibleSolution.x,
-			possibleSolution.x, target,
-			0);
-	}
+RayTriangleIntersection noIntersection() {
+	return RayTriangleIntersection(glm::vec3(0, 0, 0), std::numeric_limits<float>::max(), 0);
+}
 
+// Misses are given a material too, so callers can look at it to decide whether to shade.
+IMaterial* getMaterial(const RayTriangleIntersection& intersection, const SceneView& scene) {
+	static UniformColourMaterial missMaterial = UniformColourMaterial(Colour(0, 0, 0));
+	if (intersection.distance == std::numeric_limits<float>::max()) return &missMaterial;
+	return scene.getMaterial(intersection.triangleIndex);
+}
+
+RayTriangleIntersection makeIntersection(glm::vec3 startPosition, glm::vec3 direction, const TriangleHit& hit, const SceneView& scene) {
+	if (hit.triangleIndex == -1) return noIntersection();
+	RayTriangleIntersection result = RayTriangleIntersection(startPosition + (direction * hit.t),
+		hit.t,
+		hit.triangleIndex);
+	result.u = hit.u;
+	result.v = hit.v;
 	return result;
 }
 
 RayTriangleIntersection getClosestIntersection(glm::vec3 startPosition,
 	glm::vec3 direction,
-	std::vector<ModelTriangle> targets,
+	const SceneView& scene,
 	int indexBlacklist) {
 
-	RayTriangleIntersection result = RayTriangleIntersection(glm::vec3(0, 0, 0),
-		std::numeric_limits<float>::max(),
-		ModelTriangle(Vertex(), Vertex(), Vertex(), 
-			&UniformColourMaterial(Colour(0, 0, 0)), 
-			glm::vec3(0, 0, 0)),
-		0);
-
-	for (int i = 0; i < targets.size(); i++) {
-		if (i != indexBlacklist) {
-			RayTriangleIntersection possibleResult = getIntersection(startPosition, direction, targets[i]);
-			possibleResult.triangleIndex = i;
-			if (possibleResult.distance < result.distance) {
-				result = possibleResult;
-			}
-		}
+	Ray ray = makeRay(startPosition, direction);
+	TriangleHit hit = noHit();
+	if (!scene.bvh.isEmpty()) {
+		scene.bvh.getClosestHit(ray, scene.geometry, indexBlacklist, hit);
+	}
+	else {
+		scene.geometry.intersect(ray, 0, scene.geometry.size(), indexBlacklist, hit);
+	}
+	int modelSize = scene.triangles.size();
+	if (!scene.instances.isEmpty() && scene.instances.getClosestHit(ray, indexBlacklist - modelSize, hit)) {
+		hit.triangleIndex += modelSize;
 	}
+	return makeIntersection(startPosition, direction, hit, scene);
+}
 
-	return result;
+bool occluded(glm::vec3 startPosition,
+	glm::vec3 direction,
+	float maxDistance,
+	const SceneView& scene,
+	int indexBlacklist) {
+
+	Ray ray = makeRay(startPosition, direction);
+	bool blocked = !scene.bvh.isEmpty() ?
+		scene.bvh.isOccluded(ray, scene.geometry, indexBlacklist, maxDistance) :
+		scene.geometry.occluded(ray, 0, scene.geometry.size(), indexBlacklist, maxDistance);
+	if (blocked || scene.instances.isEmpty()) return blocked;
+	return scene.instances.isOccluded(ray, indexBlacklist - (int)scene.triangles.size(), maxDistance);
 }
 
-// Returns the brightness of a point given the brightness of the 3 vertices of a triangle.
-float interpolateBrightness(RayTriangleIntersection intersection) {
-	float entireArea = triangleArea(intersection.intersectedTriangle.vertices[0].position,
-		intersection.intersectedTriangle.vertices[1].position,
-		intersection.intersectedTriangle.vertices[2].position);
-	float v0OppArea = triangleArea(intersection.intersectionPoint,
-		intersection.intersectedTriangle.vertices[1].position,
-		intersection.intersectedTriangle.vertices[2].position);
-	float v1OppArea = triangleArea(intersection.intersectedTriangle.vertices[0].position,
-		intersection.intersectionPoint,
-		intersection.intersectedTriangle.vertices[2].position);
-	float v2OppArea = triangleArea(intersection.intersectedTriangle.vertices[0].position,
-		intersection.intersectedTriangle.vertices[1].position,
-		intersection.intersectionPoint);
-	v0OppArea /= entireArea;
-	v1OppArea /= entireArea;
-	v2OppArea /= entireArea;
-	float brightness = (intersection.intersectedTriangle.vertices[0].brightness * v0OppArea) + 
-		(intersection.intersectedTriangle.vertices[1].brightness * v1OppArea) + 
-		(intersection.intersectedTriangle.vertices[2].brightness * v2OppArea);
-	return brightness;
+bool ShadowRayTracer::isOccluded(glm::vec3 startPosition, glm::vec3 direction, float maxDistance, const SceneView& scene, int indexBlacklist) {
+	return occluded(startPosition, direction, maxDistance, scene, indexBlacklist);
+}
+
+// Returns 1 if nothing lies between the point and the light, 0 otherwise.
+float hardShadowLighting(glm::vec3 point, int triangleIndex, const SceneView& scene, glm::vec3 light, ShadowRayTracer& shadowRays) {
+	glm::vec3 pointToLight = light - point;
+	float distance = glm::length(pointToLight);
+	return shadowRays.isOccluded(point, pointToLight / distance, distance, scene, triangleIndex) ? 0 : 1;
 }
 
-float hardShadowLighting(RayTriangleIntersection intersection,
-	std::vector<ModelTriangle> model,
-	std::vector<glm::vec3> lights) {
+float hardShadowLighting(const RayTriangleIntersection& intersection,
+	const SceneView& scene,
+	glm::vec3 light,
+	ShadowRayTracer& shadowRays) {
 
-	float brightness = 0;
-	float brightnessPerLight = 1.0f / lights.size();
-	for (int i = 0; i < lights.size(); i++) {
-		glm::vec3 pointToLight = lights[i] - intersection.intersectionPoint;
-		RayTriangleIntersection lightIntersection = getClosestIntersection(intersection.intersectionPoint,
-			glm::normalize(pointToLight),
-			model,
-			intersection.triangleIndex);
+	return hardShadowLighting(intersection.intersectionPoint, intersection.triangleIndex, scene, light, shadowRays);
+}
 
-		brightness += lightIntersection.distance < glm::length(pointToLight) ? 0 : brightnessPerLight;
+// With no more lights than the budget every light is tried, otherwise the budget's worth are picked
+// from the light tree, one from each equal slice of [0, 1), and weighted by the chance they had of being picked.
+float unblockedLight(glm::vec3 point, int triangleIndex, const SceneView& scene, ShadowRayTracer& shadowRays,
+	RandomStream random, int firstDimension) {
+
+	const LightTree* tree = scene.lightTree;
+	int lightCount = tree ? tree->getLightCount() : scene.lights.size();
+	int budget = std::min(scene.lightSampling.lightBudget, MAX_LIGHT_SAMPLES);
+	bool sampled = tree && (lightCount > budget);
+	int rayCount = sampled ? budget : lightCount;
+	int lightIndices[MAX_LIGHT_SAMPLES];
+	float probabilities[MAX_LIGHT_SAMPLES];
+	if (sampled) {
+		float u[MAX_LIGHT_SAMPLES];
+		for (int i = 0; i < rayCount; i++) u[i] = (i + random.get(i, firstDimension)) / rayCount;
+		tree->sample(point, u, rayCount, lightIndices, probabilities);
 	}
-	return brightness;
+	float reaching = 0;
+	float unblocked = 0;
+	for (int i = 0; i < rayCount; i++) {
+		int lightIndex = sampled ? lightIndices[i] : i;
+		if (lightIndex == -1) continue;
+		Light light = tree ? tree->lights[lightIndex] : Light::point(scene.lights[lightIndex]);
+		glm::vec3 lightPoint = light.getPoint(glm::vec2(random.get(i, firstDimension + 1), random.get(i, firstDimension + 2)));
+		float weight = light.getWeight(lightPoint, point);
+		if (sampled) weight /= probabilities[i];
+		if (weight <= 0) continue;
+		glm::vec3 direction = glm::normalize(lightPoint - point);
+		reaching += weight;
+		unblocked += weight * hardShadowLighting(point + (direction * SHADOW_BIAS), triangleIndex, scene, lightPoint, shadowRays);
+	}
+	return reaching > 0 ? unblocked / reaching : 0;
 }
 
-float vertexHardShadowLighting(RayTriangleIntersection intersection,
-	std::vector<ModelTriangle> model,
-	std::vector<glm::vec3> lights) {
-
-	glm::vec3 v0 = intersection.intersectedTriangle.vertices[0].position;
-	glm::vec3 v1 = intersection.intersectedTriangle.vertices[1].position;
-	glm::vec3 v2 = intersection.intersectedTriangle.vertices[2].position;
-
-	RayTriangleIntersection v0Intersection = getClosestIntersection(v0,
-		glm::vec3(0,0,0),
-		model,
-		intersection.triangleIndex);
-	RayTriangleIntersection v1Intersection = getClosestIntersection(v1,
-		glm::vec3(0,0,0),
-		model,
-		intersection.triangleIndex);
-	RayTriangleIntersection v2Intersection = getClosestIntersection(v2,
-		glm::vec3(0,0,0),
-		model,
-		intersection.triangleIndex);
-
-	intersection.intersectedTriangle.vertices[0].brightness = hardShadowLighting(v0Intersection, model, lights);
-	intersection.intersectedTriangle.vertices[1].brightness = hardShadowLighting(v1Intersection, model, lights);
-	intersection.intersectedTriangle.vertices[2].brightness = hardShadowLighting(v2Intersection, model, lights);
-
-	return interpolateBrightness(intersection);
+float gouraudLighting(const RayTriangleIntersection& intersection, float i0, float i1, float i2) {
+	float intensity = (i0 * (1 - intersection.u - intersection.v)) + (i1 * intersection.u) + (i2 * intersection.v);
+	return intensity;
+}
+
+// Shadows each vertex of the triangle and interpolates them across it. Vertices are shared with
+// the neighbouring triangles, so each shadow ray starts a little way towards its light and, as in
+// VertexLightCache, no triangle is left out of it. The renderers shadow every vertex once for the
+// frame, and only scenes without their cache trace here.
+float vertexHardShadowLighting(const RayTriangleIntersection& intersection, const ModelTriangle& triangle, const SceneView& scene,
+	ShadowRayTracer& shadowRays, RandomStream random) {
+	glm::vec3 brightnesses;
+	if (scene.vertexLighting) brightnesses = scene.vertexLighting->getBrightnesses(intersection.triangleIndex);
+	else {
+		for (int i = 0; i < 3; i++) {
+			brightnesses[i] = unblockedLight(triangle.vertices[i].position, std::numeric_limits<int>::max(), scene, shadowRays, random, i * 3);
+		}
+	}
+	return gouraudLighting(intersection, brightnesses[0], brightnesses[1], brightnesses[2]);
 }
 
-float proximityLighting(RayTriangleIntersection intersection, glm::vec3 light, float strength = 12.5) {
+float proximityLighting(const RayTriangleIntersection& intersection, glm::vec3 light, float strength = 12.5) {
 	float distance = glm::length(intersection.intersectionPoint - light);
 	float brightness = strength / (4 * PI * distance * distance);
 	brightness = std::min(brightness, 1.0f);
 	return brightness;
 }
 
-float incidenceLighting(RayTriangleIntersection intersection, glm::vec3 light, glm::vec3 normal = { 0, 0, 0 }) {
-	if (normal == glm::vec3(0, 0, 0)) normal = intersection.intersectedTriangle.normal;
+float incidenceLighting(const RayTriangleIntersection& intersection, glm::vec3 light, glm::vec3 normal) {
 	glm::vec3 pointToLight = glm::normalize(light - intersection.intersectionPoint);
 	float similarity = std::max(glm::dot(pointToLight, normal), 0.0f);
 	return similarity;
 }
 
-float specularLighting(RayTriangleIntersection intersection, glm::vec3 light, int specularExponent = 128,
-	glm::vec3 normal = { 0, 0, 0 }) {
-
-	if (normal == glm::vec3(0, 0, 0)) normal = intersection.intersectedTriangle.normal;
-
+float specularLighting(const RayTriangleIntersection& intersection, glm::vec3 light, glm::vec3 cameraPosition,
+	glm::vec3 normal, int specularExponent = 128) {
 
 	glm::vec3 unitLightToPoint = glm::normalize(intersection.intersectionPoint - light);
-	glm::vec3 unitCameraToPoint = glm::normalize(intersection.intersectionPoint);
+	glm::vec3 unitCameraToPoint = glm::normalize(intersection.intersectionPoint - cameraPosition);
 	glm::vec3 unitReflection = glm::normalize(unitLightToPoint - (2.0f * normal * glm::dot(unitLightToPoint, normal)));
 
 	float reflectionSimilarity = glm::dot(unitReflection, unitCameraToPoint);
@@ -160,61 +171,40 @@ float ambientLighting(float currentIntensity, float addition = 0.2) {
 	return std::min(currentIntensity + addition, 1.0f);
 }
 
-float gouraudLighting(RayTriangleIntersection intersection, float i0, float i1, float i2) {
-	float entireArea = triangleArea(intersection.intersectedTriangle.vertices[0].position,
-		intersection.intersectedTriangle.vertices[1].position,
-		intersection.intersectedTriangle.vertices[2].position);
-	float v0OppArea = triangleArea(intersection.intersectionPoint,
-		intersection.intersectedTriangle.vertices[1].position,
-		intersection.intersectedTriangle.vertices[2].position);
-	float v1OppArea = triangleArea(intersection.intersectedTriangle.vertices[0].position,
-		intersection.intersectionPoint,
-		intersection.intersectedTriangle.vertices[2].position);
-	float v2OppArea = triangleArea(intersection.intersectedTriangle.vertices[0].position,
-		intersection.intersectedTriangle.vertices[1].position,
-		intersection.intersectionPoint);
-	v0OppArea /= entireArea;
-	v1OppArea /= entireArea;
-	v2OppArea /= entireArea;
-	float intensity = (i0 * v0OppArea) + (i1 * v1OppArea) + (i2 * v2OppArea);
-	return intensity;
+glm::vec3 phongLighting(const RayTriangleIntersection& intersection, const ModelTriangle& triangle) {
+	glm::vec3 normal = (triangle.vertices[0].normal * (1 - intersection.u - intersection.v)) +
+		(triangle.vertices[1].normal * intersection.u) +
+		(triangle.vertices[2].normal * intersection.v);
+	// Triangles without vertex normals are lit by their face normal.
+	if (normal == glm::vec3(0, 0, 0)) normal = triangle.normal;
+	return normal;
 }
 
-glm::vec3 phongLighting(RayTriangleIntersection intersection) {
-	float entireArea = triangleArea(intersection.intersectedTriangle.vertices[0].position,
-		intersection.intersectedTriangle.vertices[1].position,
-		intersection.intersectedTriangle.vertices[2].position);
-	float v0OppArea = triangleArea(intersection.intersectionPoint,
-		intersection.intersectedTriangle.vertices[1].position,
-		intersection.intersectedTriangle.vertices[2].position);
-	float v1OppArea = triangleArea(intersection.intersectedTriangle.vertices[0].position,
-		intersection.intersectionPoint,
-		intersection.intersectedTriangle.vertices[2].position);
-	float v2OppArea = triangleArea(intersection.intersectedTriangle.vertices[0].position,
-		intersection.intersectedTriangle.vertices[1].position,
-		intersection.intersectionPoint);
-	v0OppArea /= entireArea;
-	v1OppArea /= entireArea;
-	v2OppArea /= entireArea;
-	glm::vec3 normal = (intersection.intersectedTriangle.vertices[0].normal * v0OppArea) +
-		(intersection.intersectedTriangle.vertices[1].normal * v1OppArea) +
-		(intersection.intersectedTriangle.vertices[2].normal * v2OppArea);
-	return normal;
+float calculateBrightness(const RayTriangleIntersection& intersection,
+	LightingMode lightingMode,
+	const SceneView& scene,
+	RandomStream random) {
+
+	ShadowRayTracer shadowRays;
+	return calculateBrightness(intersection, lightingMode, scene, shadowRays, random);
 }
 
-float calculateBrightness(RayTriangleIntersection intersection,
+float calculateBrightness(const RayTriangleIntersection& intersection,
 	LightingMode lightingMode,
-	std::vector<ModelTriangle> model,
-	std::vector<glm::vec3> lights) {
+	const SceneView& scene,
+	ShadowRayTracer& shadowRays,
+	RandomStream random) {
 	if ((intersection.triangleIndex > 31) && (lightingMode == AMBIENT)) lightingMode = PHONG;
+	// Indirect light, added by calculateLighting, takes the place of the constant ambient term.
+	float ambient = scene.indirectLighting ? 0.0f : 0.2f;
 	float intensity = 1;
-	glm::vec3 light = lights[0];
+	glm::vec3 light = scene.lights[0];
 	if (intersection.distance == std::numeric_limits<float>::max())
 		intensity = 0;
 	else {
 		switch (lightingMode) {
 		case HARD:
-			//intensity = hardShadowLighting(intersection, model, {light});
+			//intensity = hardShadowLighting(intersection, scene, light);
 			intensity = 1;
 			break;
 		case PROXIMITY:
@@ -222,13 +212,14 @@ float calculateBrightness(RayTriangleIntersection intersection,
 			break;
 		case INCIDENCE:
 			intensity = proximityLighting(intersection, light);
-			intensity *= incidenceLighting(intersection, light);
+			intensity *= incidenceLighting(intersection, light, scene.getNormal(intersection.triangleIndex));
 			break;
 		case SPECULAR:
 		{
+			glm::vec3 normal = scene.getNormal(intersection.triangleIndex);
 			intensity = proximityLighting(intersection, light);
-			intensity *= incidenceLighting(intersection, light);
-			float spec = specularLighting(intersection, light);
+			intensity *= incidenceLighting(intersection, light, normal);
+			float spec = specularLighting(intersection, light, scene.cam.position, normal);
 			if (spec > 0.1) std::cout << "Specular: " << spec << '\n';
 			intensity += spec;
 			intensity = glm::min(intensity, 1.0f);
@@ -237,44 +228,57 @@ float calculateBrightness(RayTriangleIntersection intersection,
 		case AMBIENT:
 		{
 			glm::vec3 lightCenter = light;
+			glm::vec3 normal = scene.getNormal(intersection.triangleIndex);
 			intensity = proximityLighting(intersection, lightCenter);
-			intensity *= incidenceLighting(intersection, lightCenter);
-			intensity += specularLighting(intersection, lightCenter);
+			intensity *= incidenceLighting(intersection, lightCenter, normal);
+			intensity += specularLighting(intersection, lightCenter, scene.cam.position, normal);
 			intensity = glm::min(intensity, 1.0f);
 
-			int numLights = 10;
+			int numLights = scene.lightSampling.sampleCount;
 			float lightRadius = 0.5;
 			float shadowIntensity = 0;
 			for (int i = 0; i < numLights; i++) {
-				float v0 = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-				float v1 = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-				float v2 = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-				glm::vec3 lightPos = lightCenter + (lightRadius * glm::normalize(glm::vec3(v0, v1, v2)));
-				shadowIntensity += hardShadowLighting(intersection, model, { lightPos });
+				// The light is the eighth of a sphere facing +x, +y and +z, and the square maps evenly onto it.
+				glm::vec2 sample = getSamplePoint(scene.lightSampling.pattern, random, i, numLights);
+				float z = sample.x;
+				float r = std::sqrt(std::max(0.0f, 1 - (z * z)));
+				float angle = sample.y * (PI / 2);
+				glm::vec3 lightPos = lightCenter + (lightRadius * glm::vec3(r * std::cos(angle), r * std::sin(angle), z));
+				shadowIntensity += hardShadowLighting(intersection, scene, lightPos, shadowRays);
 			}
 			shadowIntensity /= numLights;
 
 			intensity *= shadowIntensity;
-			intensity = ambientLighting(intensity);
+			intensity = ambientLighting(intensity, ambient);
 
 			break;
 		}
 		case GOURAUD:
 		{
-			intensity = interpolateBrightness(intersection);
-			intensity *= vertexHardShadowLighting(intersection, model, lights);
-			intensity = ambientLighting(intensity);
+			// Each vertex is lit by its own normal and the result blended across the triangle.
+			ModelTriangle triangle = scene.getTriangle(intersection.triangleIndex);
+			float vertexIntensities[3];
+			for (int i = 0; i < 3; i++) {
+				glm::vec3 normal = triangle.vertices[i].normal;
+				if (normal == glm::vec3(0, 0, 0)) normal = triangle.normal;
+				glm::vec3 vertexToLight = glm::normalize(light - triangle.vertices[i].position);
+				vertexIntensities[i] = std::max(glm::dot(vertexToLight, normal), 0.0f);
+			}
+			intensity = gouraudLighting(intersection, vertexIntensities[0], vertexIntensities[1], vertexIntensities[2]);
+			intensity *= vertexHardShadowLighting(intersection, triangle, scene, shadowRays, random);
+			intensity = ambientLighting(intensity, ambient);
 			break;
 		}
 		case PHONG:
 		{
-			glm::vec3 normal = phongLighting(intersection);
+			ModelTriangle triangle = scene.getTriangle(intersection.triangleIndex);
+			glm::vec3 normal = phongLighting(intersection, triangle);
 			intensity = proximityLighting(intersection, light);
 			intensity *= incidenceLighting(intersection, light, normal);
-			intensity += specularLighting(intersection, light, 256, normal);
+			intensity += specularLighting(intersection, light, scene.cam.position, normal, 256);
 			intensity = glm::min(intensity, 1.0f);
-			intensity *= vertexHardShadowLighting(intersection, model, lights);
-			intensity = ambientLighting(intensity);
+			intensity *= vertexHardShadowLighting(intersection, triangle, scene, shadowRays, random);
+			intensity = ambientLighting(intensity, ambient);
 			break;
 		}
 		}
@@ -282,65 +286,153 @@ float calculateBrightness(RayTriangleIntersection intersection,
 	return intensity;
 }
 
-void rayTracedRender(std::vector<ModelTriangle> model,
-	std::vector<glm::vec3> lights,
-	DrawingWindow& window,
-	Camera cam,
-	LightingMode lightingMode) {
+float diffuseLighting(const RayTriangleIntersection& intersection, const SceneView& scene, ShadowRayTracer& shadowRays, RandomStream random) {
+	glm::vec3 light = scene.lights[0];
+	float intensity = proximityLighting(intersection, light) * incidenceLighting(intersection, light, scene.getNormal(intersection.triangleIndex));
+	if (intensity == 0) return 0;
+	return intensity * unblockedLight(intersection.intersectionPoint, intersection.triangleIndex, scene, shadowRays, random, 0);
+}
+
+// Gathering at a point no record covers would cost a pixel as much as a record does, so it takes the
+// nearest record's light instead.
+glm::vec3 indirectLighting(const RayTriangleIntersection& intersection, LightingMode lightingMode, const SceneView& scene) {
+	if (!scene.indirectLighting || !shadesIndirect(lightingMode) || !scene.irradianceCache) return glm::vec3(0, 0, 0);
+	if (intersection.distance == std::numeric_limits<float>::max()) return glm::vec3(0, 0, 0);
+	glm::vec3 irradiance;
+	scene.irradianceCache->estimate(intersection.intersectionPoint, scene.getNormal(intersection.triangleIndex), irradiance);
+	return irradiance;
+}
+
+glm::vec3 calculateLighting(const RayTriangleIntersection& intersection,
+	LightingMode lightingMode,
+	const SceneView& scene,
+	RandomStream random) {
+
+	ShadowRayTracer shadowRays;
+	return calculateLighting(intersection, lightingMode, scene, shadowRays, random);
+}
 
-	for (int i = 0; i < lights.size(); i++) {
-		lights[i] = cam.orientation * (lights[i] - cam.position);
+glm::vec3 calculateLighting(const RayTriangleIntersection& intersection,
+	LightingMode lightingMode,
+	const SceneView& scene,
+	ShadowRayTracer& shadowRays,
+	RandomStream random) {
+
+	float brightness = calculateBrightness(intersection, lightingMode, scene, shadowRays, random);
+	return glm::min(glm::vec3(brightness) + indirectLighting(intersection, lightingMode, scene), 1.0f);
+}
+
+glm::vec3 getCameraRayDirection(int i, int j, const SceneView& scene, const glm::mat3& cameraToWorld, DrawingWindow& window) {
+	glm::vec3 direction = { (i - window.width / 2) / window.scale, (window.height / 2 - j) / window.scale, -scene.cam.focalLength };
+	return glm::normalize(cameraToWorld * direction);
+}
+
+uint32_t shadePixel(const RayTriangleIntersection& intersection, const SceneView& scene, LightingMode lightingMode, RandomStream random) {
+	IMaterial* material = getMaterial(intersection, scene);
+	glm::vec3 lighting = glm::vec3(1, 1, 1);
+	if (material->recievesShadow)
+		lighting = calculateLighting(intersection, lightingMode, scene, random);
+
+	Colour colour;
+	if (intersection.distance == std::numeric_limits<float>::max()) {
+		colour = Colour(0, 0, 0);
 	}
-	glm::vec3 light = lights[0];
+	else {
+		colour = material->GetColour(scene, lightingMode, intersection, random);
+		colour.red *= lighting.r;
+		colour.blue *= lighting.b;
+		colour.green *= lighting.g;
+	}
+	return colour.getPackedColour();
+}
 
-	for (int i = 0; i < model.size(); i++) {
-		for (int j = 0; j < 3; j++) {
-			model[i].vertices[j].position = cam.orientation * (model[i].vertices[j].position - cam.position);
-			model[i].vertices[j].normal = cam.orientation * model[i].vertices[j].normal;
+// Only the model's BVH is traced as a packet, and only with AVX2. Instances are traced one ray at a time.
+void getCameraHits(int x, int y, int width, int height, const SceneView& scene, const glm::mat3& cameraToWorld,
+	DrawingWindow& window, RayTriangleIntersection* intersections) {
+
+	glm::vec3 directions[PACKET_SIZE];
+	int count = 0;
+	for (int j = 0; j < height; j++) {
+		for (int i = 0; i < width; i++) {
+			directions[count] = getCameraRayDirection(x + i, y + j, scene, cameraToWorld, window);
+			count++;
 		}
-		model[i].normal = cam.orientation * model[i].normal;
 	}
-
-	if (lightingMode == GOURAUD) {
-		for (int i = 0; i < model.size(); i++) {
-			for (int j = 0; j < 3; j++) {
-				glm::vec3 vertexPosition = model[i].vertices[j].position;
-				RayTriangleIntersection intersection = RayTriangleIntersection(vertexPosition,
-					glm::length(vertexPosition),
-					model[i],
-					i);
-				float brightness = proximityLighting(intersection, light, 5.0f);
-				brightness = incidenceLighting(intersection, light, model[i].vertices[j].normal);
-				//brightness += specularLighting(intersection, light, 256, model[i].vertices[j].normal);
-				//brightness = glm::min(brightness, 1.0f);
-				model[i].vertices[j].brightness = brightness;
-			}
+	RayPacket packet = makeRayPacket(scene.cam.position, directions, count);
+	PacketHit hits = noPacketHit();
+#if TRIANGLE_LANES == 8
+	if (!scene.bvh.isEmpty()) {
+		scene.bvh.getClosestHits(packet, scene.geometry, hits);
+	}
+	else {
+		scene.geometry.intersect(packet, 0, scene.geometry.size(), (1 << count) - 1, hits);
+	}
+#endif
+
+	int modelSize = scene.triangles.size();
+	for (int lane = 0; lane < count; lane++) {
+		TriangleHit hit = getPacketHit(hits, lane);
+#if TRIANGLE_LANES != 8
+		// Without AVX2 the packet kernels loop over the lanes, which loses to single rays on big scenes.
+		if (!scene.bvh.isEmpty()) scene.bvh.getClosestHit(packet.rays[lane], scene.geometry, std::numeric_limits<int>::max(), hit);
+		else scene.geometry.intersect(packet.rays[lane], 0, scene.geometry.size(), std::numeric_limits<int>::max(), hit);
+#endif
+		if (!scene.instances.isEmpty() && scene.instances.getClosestHit(packet.rays[lane], std::numeric_limits<int>::max() - modelSize, hit)) {
+			hit.triangleIndex += modelSize;
 		}
+		intersections[lane] = makeIntersection(scene.cam.position, directions[lane], hit, scene);
 	}
+}
 
-	for (int i = 0; i < window.width; i++) {
-		for (int j = 0; j < window.height; j++) {
-
-			glm::vec3 direction = { (i - window.width / 2) / window.scale, (window.height / 2 - j) / window.scale, -cam.focalLength };
-			direction = glm::normalize(direction);
-			RayTriangleIntersection intersection = getClosestIntersection(glm::vec3(0, 0, 0), direction, model);
+// Traces the camera rays through a block of pixels as one packet, then shades them one at a time
+// into colours, whose rows are stride apart. Every ray after the first bounce is traced on its own.
+void tracePacket(int x, int y, int width, int height, const SceneView& scene, const glm::mat3& cameraToWorld,
+	DrawingWindow& window, LightingMode lightingMode, uint32_t* colours, int stride) {
 
-			float intensity = 1;
-			if (intersection.intersectedTriangle.material->recievesShadow)
-				intensity = calculateBrightness(intersection, lightingMode, model, lights);
+	RayTriangleIntersection intersections[PACKET_SIZE];
+	getCameraHits(x, y, width, height, scene, cameraToWorld, window, intersections);
+	for (int lane = 0; lane < width * height; lane++) {
+		RandomStream random = RandomStream(scene.frame, x + (lane % width), y + (lane / width));
+		colours[((lane / width) * stride) + (lane % width)] = shadePixel(intersections[lane], scene, lightingMode, random);
+	}
+}
 
-			Colour colour;
-			if (intersection.distance == std::numeric_limits<float>::max()) {
-				colour = Colour(0, 0, 0);
+void rayTracedRender(const SceneView& worldScene,
+	DrawingWindow& window,
+	LightingMode lightingMode,
+	int threadCount) {
+
+	// Everything stays in world space, only the camera rays are turned to match the camera, so the
+	// geometry and anything built from it stay valid while the camera moves.
+	FrameScene frameScene(worldScene, window, lightingMode, threadCount);
+	const SceneView& scene = frameScene.getView();
+	glm::mat3 cameraToWorld = glm::inverse(scene.cam.orientation);
+
+	// Tiles are one cache line of pixels wide, each is shaded into its thread's scratch buffer
+	// and only copied into the window once it is finished.
+	int tilesAcross = (window.width + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesDown = (window.height + TILE_SIZE - 1) / TILE_SIZE;
+	ThreadPool& pool = getThreadPool(threadCount);
+	std::vector<std::array<uint32_t, TILE_SIZE * TILE_SIZE>> tileBuffers(pool.getThreadCount());
+
+	pool.run(tilesAcross * tilesDown, [&](int tileIndex, int threadIndex) {
+		std::array<uint32_t, TILE_SIZE * TILE_SIZE>& tile = tileBuffers[threadIndex];
+		int tileX = (tileIndex % tilesAcross) * TILE_SIZE;
+		int tileY = (tileIndex / tilesAcross) * TILE_SIZE;
+		int tileWidth = std::min(TILE_SIZE, window.width - tileX);
+		int tileHeight = std::min(TILE_SIZE, window.height - tileY);
+
+		for (int y = 0; y < tileHeight; y += PACKET_HEIGHT) {
+			for (int x = 0; x < tileWidth; x += PACKET_WIDTH) {
+				int width = std::min(PACKET_WIDTH, tileWidth - x);
+				int height = std::min(PACKET_HEIGHT, tileHeight - y);
+				tracePacket(tileX + x, tileY + y, width, height, scene, cameraToWorld, window, lightingMode, &tile[(y * TILE_SIZE) + x], TILE_SIZE);
 			}
-			else {
-				colour = intersection.intersectedTriangle.GetColour(model, lights, cam, lightingMode,
-					intersection.triangleIndex, intersection.intersectionPoint);
-				colour.red *= intensity;
-				colour.blue *= intensity;
-				colour.green *= intensity;
+		}
+		for (int y = 0; y < tileHeight; y++) {
+			for (int x = 0; x < tileWidth; x++) {
+				window.setPixelColour(tileX + x, tileY + y, tile[(y * TILE_SIZE) + x]);
 			}
-			window.setPixelColour(i, j, colour.getPackedColour());
 		}
-	}
+	});
 }
\ No newline at end of file
@@ -6,19 +6,94 @@
 #include <DrawingWindow.h>
 #include <Objects.h>
 #include <RayTriangleIntersection.h>
+#include <BVH.h>
+#include <SceneView.h>
+#include <Random.h>
 
-void rayTracedRender(std::vector<ModelTriangle> model,
-	std::vector<glm::vec3> light,
+// The block of pixels whose camera rays are traced as one packet.
+#define PACKET_WIDTH 4
+#define PACKET_HEIGHT (PACKET_SIZE / PACKET_WIDTH)
+
+void rayTracedRender(const SceneView& scene,
 	DrawingWindow& window,
-	Camera cam,
-	LightingMode lightingMode);
+	LightingMode lightingMode,
+	int threadCount = 1);
+
+RayTriangleIntersection noIntersection();
+
+// The material of the triangle the intersection is on. Misses get a black one that receives shadow.
+IMaterial* getMaterial(const RayTriangleIntersection& intersection, const SceneView& scene);
 
 RayTriangleIntersection getClosestIntersection(glm::vec3 startPosition,
 	glm::vec3 direction,
-	std::vector<ModelTriangle> targets,
+	const SceneView& scene,
 	int indexBlacklist = std::numeric_limits<int>::max());
 
-float calculateBrightness(RayTriangleIntersection intersection,
+// Whether anything lies along the ray closer than maxDistance. It stops at the first blocker it
+// finds, so shadow rays should use it rather than looking for the closest intersection.
+bool occluded(glm::vec3 startPosition,
+	glm::vec3 direction,
+	float maxDistance,
+	const SceneView& scene,
+	int indexBlacklist = std::numeric_limits<int>::max());
+
+// Answers the shadow rays the lighting asks for. This one traces each ray as soon as it is asked
+// about; the wavefront renderer swaps in ones that queue the rays and later replay the traced answers.
+class ShadowRayTracer {
+public:
+	virtual ~ShadowRayTracer() {}
+	virtual bool isOccluded(glm::vec3 startPosition, glm::vec3 direction, float maxDistance, const SceneView& scene, int indexBlacklist);
+};
+
+// Any lights sampled at random are picked with numbers from random.
+float calculateBrightness(const RayTriangleIntersection& intersection,
 	LightingMode lightingMode,
-	std::vector<ModelTriangle> model,
-	std::vector<glm::vec3> lights);
\ No newline at end of file
+	const SceneView& scene,
+	RandomStream random);
+
+// The same, with the shadow rays answered by shadowRays. How many it asks about never depends on the answers.
+float calculateBrightness(const RayTriangleIntersection& intersection,
+	LightingMode lightingMode,
+	const SceneView& scene,
+	ShadowRayTracer& shadowRays,
+	RandomStream random);
+
+// The brightness of each colour channel: calculateBrightness's, plus the indirect light when the scene has it.
+glm::vec3 calculateLighting(const RayTriangleIntersection& intersection,
+	LightingMode lightingMode,
+	const SceneView& scene,
+	RandomStream random);
+
+glm::vec3 calculateLighting(const RayTriangleIntersection& intersection,
+	LightingMode lightingMode,
+	const SceneView& scene,
+	ShadowRayTracer& shadowRays,
+	RandomStream random);
+
+// The diffuse light bounced onto the intersection off other surfaces, from the scene's irradiance cache.
+// Black without indirect lighting or a cache, or in modes that don't use it.
+glm::vec3 indirectLighting(const RayTriangleIntersection& intersection, LightingMode lightingMode, const SceneView& scene);
+
+// How brightly a diffuse surface is lit at the intersection straight from the lights, as INCIDENCE
+// lights it but shadowed the way GOURAUD and PHONG are. This is the light it passes on to others.
+float diffuseLighting(const RayTriangleIntersection& intersection, const SceneView& scene, ShadowRayTracer& shadowRays, RandomStream random);
+
+// The share of the light reaching point that nothing blocks, each light weighted by how strongly it
+// reaches the point. Shadow rays leave out the triangle with index triangleIndex. Draws from
+// dimensions firstDimension to firstDimension + 2 of random.
+float unblockedLight(glm::vec3 point, int triangleIndex, const SceneView& scene, ShadowRayTracer& shadowRays,
+	RandomStream random, int firstDimension);
+
+// Turns a hit along the ray into the intersection the shading code works with.
+RayTriangleIntersection makeIntersection(glm::vec3 startPosition, glm::vec3 direction, const TriangleHit& hit, const SceneView& scene);
+
+// The colour rayTracedRender gives a pixel whose camera ray found intersection, random is the pixel's stream.
+uint32_t shadePixel(const RayTriangleIntersection& intersection, const SceneView& scene, LightingMode lightingMode, RandomStream random);
+
+// The camera ray through pixel (i, j), in world space. cameraToWorld is the inverse of the camera's orientation.
+glm::vec3 getCameraRayDirection(int i, int j, const SceneView& scene, const glm::mat3& cameraToWorld, DrawingWindow& window);
+
+// The closest hits of the camera rays through a block of at most PACKET_WIDTH by PACKET_HEIGHT
+// pixels starting at (x, y), traced as one packet and written to intersections row by row.
+void getCameraHits(int x, int y, int width, int height, const SceneView& scene, const glm::mat3& cameraToWorld,
+	DrawingWindow& window, RayTriangleIntersection* intersections);
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <vector>
 #include <unordered_map>
 #include <sstream>
+#include <thread>
+#include <algorithm>
 
 // SDW
 #include <DrawingWindow.h>
@@ -16,9 +18,17 @@
 #include <Raytracing.h>
 #include <MirrorMaterial.h>
 #include <UniformColourMaterial.h>
+#include <Benchmarking.h>
+#include <SceneCache.h>
+#include <InstanceSet.h>
+#include <Wavefront.h>
+#include <Deferred.h>
+#include <Random.h>
+#include <IrradianceCache.h>
 
 // GLM
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #define WIDTH 640
 #define HEIGHT 480
@@ -80,6 +90,12 @@ void handleEvent(SDL_Event event, DrawingWindow& window, Camera* cam, RendererSt
 			case SDLK_4:
 				(*state).renderMode = RAYTRACED;
 				break;
+			case SDLK_r:
+				(*state).renderMode = WAVEFRONT;
+				break;
+			case SDLK_t:
+				(*state).renderMode = DEFERRED;
+				break;
 			case SDLK_5:
 				(*state).lightingMode = HARD;
 				break;
@@ -98,6 +114,9 @@ void handleEvent(SDL_Event event, DrawingWindow& window, Camera* cam, RendererSt
 			case SDLK_0:
 				(*state).lightingMode = PHONG;
 				break;
+			case SDLK_g:
+				(*state).indirectLighting = !(*state).indirectLighting;
+				break;
 			default:
 				break;
 		}
@@ -116,6 +135,17 @@ int main(int argc, char* argv[]) {
 	state.renderMode = POINTCLOUD;
 	state.orbiting = false;
 	state.lightingMode = HARD;
+	state.threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+	state.indirectLighting = false;
+
+	// Usage: RedNoise [--threads n] [--indirect 0|1] [--benchmark name]
+	std::string benchmarkName = "";
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string flag = argv[i];
+		if (flag == "--threads") state.threadCount = std::stoi(argv[i + 1]);
+		else if (flag == "--indirect") state.indirectLighting = std::stoi(argv[i + 1]) != 0;
+		else if (flag == "--benchmark") benchmarkName = argv[i + 1];
+	}
 
 	Camera mainCamera;
 	mainCamera.focalLength = 2;
@@ -128,10 +158,11 @@ int main(int argc, char* argv[]) {
 	float lightRadius = 0.5;
 	std::vector<glm::vec3> lights = {lightCenter};
 	int numLights = 20;
+	RandomStream lightJitter;
 	for (int i = 0; i < numLights - 1; i++) {
-		float v0 = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-		float v1 = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-		float v2 = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
+		float v0 = lightJitter.get(i, 0);
+		float v1 = lightJitter.get(i, 1);
+		float v2 = lightJitter.get(i, 2);
 		glm::vec3 lightPos = lightCenter + (lightRadius * glm::normalize(glm::vec3(v0, v1, v2)));
 		lights.push_back(lightPos);
 	}
@@ -145,38 +176,69 @@ int main(int argc, char* argv[]) {
 	std::unordered_map<std::string, std::vector<ModelTriangle>> models = loadModels(modelFileNames,
 		materials, {0.35, 0.2});
 
+	// The sphere is centred on its own origin and placed in the box as an instance.
 	glm::vec3 sphereCenter = getCenter(models["sphere.obj"]);
 	for (int i = 0; i < models["sphere.obj"].size(); i++) {
-		for (int j = 0; j < 3; j++) {
-			models["sphere.obj"][i].vertices[j].position -= sphereCenter;
-			models["sphere.obj"][i].vertices[j].position += glm::vec3(0.32, -0.15, 0.4);
-		}
+		for (int j = 0; j < 3; j++) models["sphere.obj"][i].vertices[j].position -= sphereCenter;
 	}
+	InstanceSet instances;
+	int sphereMesh = instances.addMesh(models["sphere.obj"]);
+	glm::mat4 spherePlacement = glm::translate(glm::mat4(1.0f), glm::vec3(0.32, -0.15, 0.4));
 
 	std::vector<ModelTriangle> currentModel(models["textured-cornell-box.obj"]);
+
+	if (!benchmarkName.empty()) {
+		// The busiest scene in the animation, the sphere inside the box with the mirrored left wall.
+		std::vector<ModelTriangle> benchmarkModel(currentModel);
+		benchmarkModel[8].material = new MirrorMaterial();
+		benchmarkModel[9].material = new MirrorMaterial();
+		instances.addInstance(sphereMesh, spherePlacement);
+		instances.buildTopLevel();
+		SceneCache sceneCache;
+		sceneCache.update(benchmarkModel, instances);
+		SceneView scene = sceneCache.getView(benchmarkModel, instances, lights, mainCamera);
+		runBenchmark(benchmarkName, scene, window, state);
+		return 0;
+	}
 	//printVec3(getCenter({ currentModel[8], currentModel[9] }));
 
-	//currentModel.insert(currentModel.end(), models["sphere.obj"].begin(), models["sphere.obj"].end());
+	//instances.addInstance(sphereMesh, spherePlacement);
+	//instances.buildTopLevel();
 	//currentModel[8].material = new MirrorMaterial();
 	//currentModel[9].material = new MirrorMaterial();
 	//
+	//SceneCache interactiveSceneCache;
+	//IrradianceCache interactiveIrradianceCache;
 	//while (true) {
 	//	if (window.pollForInputEvents(event)) handleEvent(event, window, &mainCamera, &state);
 	//
 	//	window.clearPixels();
 	//
+	//	interactiveSceneCache.update(currentModel, instances);
+	//	SceneView scene = interactiveSceneCache.getView(currentModel, instances, lights, mainCamera);
+	//	if (state.indirectLighting && shadesIndirect(state.lightingMode)) {
+	//		scene.indirectLighting = true;
+	//		interactiveIrradianceCache.update(scene, window, state.threadCount);
+	//		scene.irradianceCache = &interactiveIrradianceCache;
+	//	}
 	//	switch (state.renderMode) {
 	//		case POINTCLOUD:
-	//			pointcloudRender(currentModel, window, mainCamera);
+	//			pointcloudRender(scene, window);
 	//			break;
 	//		case WIREFRAME:
-	//			wireframeRender(currentModel, window, mainCamera);
+	//			wireframeRender(scene, window);
 	//			break;
 	//		case RASTERISED:
-	//			rasterisedRender(currentModel, window, mainCamera);
+	//			rasterisedRender(scene, window, state.threadCount);
 	//			break;
 	//		case RAYTRACED:
-	//			rayTracedRender(currentModel, lights, window, mainCamera, state.lightingMode);
+	//			rayTracedRender(scene, window, state.lightingMode, state.threadCount);
+	//			break;
+	//		case WAVEFRONT:
+	//			wavefrontRender(scene, window, state.lightingMode, state.threadCount);
+	//			break;
+	//		case DEFERRED:
+	//			deferredRender(scene, window, state.lightingMode, state.threadCount);
 	//			break;
 	//	}
 	//	
@@ -192,22 +254,44 @@ int main(int argc, char* argv[]) {
 	glm::vec3 oldOldCamPos = {};
 
 
+	// The model's geometry never changes, the material swaps at frames 12 and 36 leave it valid and
+	// the sphere arrives as an instance with its own BVH.
+	SceneCache sceneCache;
+	// Indirect light is gathered once for the whole animation, each frame only fills in the surfaces
+	// it sees for the first time. The material swaps change the light bouncing around, so they start
+	// it again.
+	IrradianceCache irradianceCache;
+
 	// 10s = 120frames
 	for (int i = 0; i < 108; i++) {
 		window.clearPixels();
 
+		sceneCache.update(currentModel, instances);
+		SceneView scene = sceneCache.getView(currentModel, instances, lights, mainCamera);
+		scene.frame = i;
+		if (state.indirectLighting && shadesIndirect(state.lightingMode)) {
+			scene.indirectLighting = true;
+			irradianceCache.update(scene, window, state.threadCount);
+			scene.irradianceCache = &irradianceCache;
+		}
 		switch (state.renderMode) {
 		case POINTCLOUD:
-			pointcloudRender(currentModel, window, mainCamera);
+			pointcloudRender(scene, window);
 			break;
 		case WIREFRAME:
-			wireframeRender(currentModel, window, mainCamera);
+			wireframeRender(scene, window);
 			break;
 		case RASTERISED:
-			rasterisedRender(currentModel, window, mainCamera);
+			rasterisedRender(scene, window, state.threadCount);
 			break;
 		case RAYTRACED:
-			rayTracedRender(currentModel, lights, window, mainCamera, state.lightingMode);
+			rayTracedRender(scene, window, state.lightingMode, state.threadCount);
+			break;
+		case WAVEFRONT:
+			wavefrontRender(scene, window, state.lightingMode, state.threadCount);
+			break;
+		case DEFERRED:
+			deferredRender(scene, window, state.lightingMode, state.threadCount);
 			break;
 		}
 
@@ -226,6 +310,7 @@ int main(int argc, char* argv[]) {
 			state.lightingMode = AMBIENT;
 			currentModel[8].material = new MirrorMaterial();
 			currentModel[9].material = new MirrorMaterial();
+			irradianceCache.clear();
 		}
 		if ((12 < i) && (i < 24)) {
 			mainCamera.position = rotateAbout(mainCamera.position, glm::vec3(0, 0, 0), glm::vec3(0, PI / 24, 0));
@@ -238,7 +323,9 @@ int main(int argc, char* argv[]) {
 		if (i == 36) {
 			currentModel[8].material = new UniformColourMaterial(Colour(255, 0, 255));
 			currentModel[9].material = new UniformColourMaterial(Colour(255, 0, 255));
-			currentModel.insert(currentModel.end(), models["sphere.obj"].begin(), models["sphere.obj"].end());
+			instances.addInstance(sphereMesh, spherePlacement);
+			instances.buildTopLevel();
+			irradianceCache.clear();
 		}
 		if ((36 < i) && (i < 48)) {
 			mainCamera.position = rotateAbout(mainCamera.position, glm::vec3(0, 0, 0), glm::vec3(0, PI / 24, 0));
@@ -0,0 +1,224 @@
+#include <Sampling.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Bits in each Sobol direction number, one for every bit of the sample index.
+#define SOBOL_BITS 32
+// Spread of the Gaussian the void and cluster method weighs neighbouring pixels by.
+#define BLUE_NOISE_SIGMA 1.5f
+
+// Direction numbers for the first two dimensions of the Sobol sequence, from the primitive
+// polynomials 1 and x + 1. Together they make a (0, 2) sequence, every power of two points from
+// the start fill each of that many equal boxes of any shape exactly once.
+struct SobolDirections {
+	uint32_t v[2][SOBOL_BITS];
+
+	SobolDirections() {
+		for (int i = 0; i < SOBOL_BITS; i++) v[0][i] = 1u << (31 - i);
+		v[1][0] = 1u << 31;
+		for (int i = 1; i < SOBOL_BITS; i++) v[1][i] = v[1][i - 1] ^ (v[1][i - 1] >> 1);
+	}
+};
+
+static const SobolDirections sobolDirections;
+
+// Both coordinates of point index. The scrambled indices use all 32 bits, each half the time, so
+// the direction numbers are masked in rather than branched on.
+static void sobol(uint32_t index, uint32_t& x, uint32_t& y) {
+	x = 0;
+	y = 0;
+	for (int bit = 0; bit < SOBOL_BITS; bit++) {
+		uint32_t mask = 0u - ((index >> bit) & 1);
+		x ^= sobolDirections.v[0][bit] & mask;
+		y ^= sobolDirections.v[1][bit] & mask;
+	}
+}
+
+static uint32_t reverseBits(uint32_t x) {
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+	x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+// Owen scrambling: flips each bit depending on all the bits above it, so the points stay as evenly
+// spread as the Sobol points were. This is Burley's hash for it from "Practical Hash-based Owen Scrambling".
+static uint32_t owenScramble(uint32_t x, uint32_t seed) {
+	x = reverseBits(x);
+	x ^= x * 0x3d20adeau;
+	x += seed;
+	x *= (seed >> 16) | 1;
+	x ^= x * 0x05526c56u;
+	x ^= x * 0x53a22864u;
+	return reverseBits(x);
+}
+
+static float toUnit(uint32_t bits) {
+	return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+// A random permutation of [0, length) that needs no table, Kensler's from "Correlated Multi-Jittered Sampling".
+static uint32_t permute(uint32_t i, uint32_t length, uint32_t seed) {
+	uint32_t mask = length - 1;
+	mask |= mask >> 1;
+	mask |= mask >> 2;
+	mask |= mask >> 4;
+	mask |= mask >> 8;
+	mask |= mask >> 16;
+	do {
+		i ^= seed;
+		i *= 0xe170893du;
+		i ^= seed >> 16;
+		i ^= (i & mask) >> 4;
+		i ^= seed >> 8;
+		i *= 0x0929eb3fu;
+		i ^= seed >> 23;
+		i ^= (i & mask) >> 1;
+		i *= 1 | (seed >> 27);
+		i *= 0x6935fa69u;
+		i ^= (i & mask) >> 11;
+		i *= 0x74dcb303u;
+		i ^= (i & mask) >> 2;
+		i *= 0x9e501cc3u;
+		i ^= (i & mask) >> 2;
+		i *= 0xc860a3dfu;
+		i &= mask;
+		i ^= i >> 5;
+	} while (i >= length);
+	return (i + seed) % length;
+}
+
+// Ranks every pixel of the tile with Ulichney's void and cluster method, so the pixels below any
+// threshold are spread as evenly as they can be. Pixels are added where the Gaussian weighted count
+// of set pixels around them is lowest. The set pixels' own count is the inverse of the unset
+// pixels', so filling the largest voids carries on past half full without switching to the clusters.
+static std::vector<float> makeBlueNoise() {
+	int size = BLUE_NOISE_SIZE;
+	int pixelCount = size * size;
+	std::vector<float> kernel(pixelCount);
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			int dx = std::min(x, size - x);
+			int dy = std::min(y, size - y);
+			kernel[(y * size) + x] = std::exp(-(dx * dx + dy * dy) / (2 * BLUE_NOISE_SIGMA * BLUE_NOISE_SIGMA));
+		}
+	}
+	std::vector<char> set(pixelCount, 0);
+	std::vector<float> energy(pixelCount, 0.0f);
+	auto toggle = [&](int pixel) {
+		set[pixel] = !set[pixel];
+		float sign = set[pixel] ? 1.0f : -1.0f;
+		int pixelX = pixel % size;
+		int pixelY = pixel / size;
+		for (int y = 0; y < size; y++) {
+			const float* row = &kernel[((y - pixelY + size) % size) * size];
+			for (int x = 0; x < size; x++) energy[(y * size) + x] += sign * row[(x - pixelX + size) % size];
+		}
+	};
+	auto tightestCluster = [&]() {
+		int best = -1;
+		for (int i = 0; i < pixelCount; i++) {
+			if (set[i] && ((best == -1) || (energy[i] > energy[best]))) best = i;
+		}
+		return best;
+	};
+	auto largestVoid = [&]() {
+		int best = -1;
+		for (int i = 0; i < pixelCount; i++) {
+			if (!set[i] && ((best == -1) || (energy[i] < energy[best]))) best = i;
+		}
+		return best;
+	};
+
+	// A tenth of the pixels at random, then moved from the tightest cluster to the largest void until that settles.
+	int initialCount = pixelCount / 10;
+	int added = 0;
+	for (uint32_t i = 0; added < initialCount; i++) {
+		int pixel = hashRandom(i) % pixelCount;
+		if (set[pixel]) continue;
+		toggle(pixel);
+		added++;
+	}
+	while (true) {
+		int cluster = tightestCluster();
+		toggle(cluster);
+		int emptiest = largestVoid();
+		toggle(emptiest);
+		if (emptiest == cluster) break;
+	}
+
+	std::vector<int> ranks(pixelCount);
+	std::vector<char> initialSet = set;
+	std::vector<float> initialEnergy = energy;
+	for (int rank = initialCount - 1; rank >= 0; rank--) {
+		int cluster = tightestCluster();
+		toggle(cluster);
+		ranks[cluster] = rank;
+	}
+	set = initialSet;
+	energy = initialEnergy;
+	for (int rank = initialCount; rank < pixelCount; rank++) {
+		int emptiest = largestVoid();
+		toggle(emptiest);
+		ranks[emptiest] = rank;
+	}
+
+	std::vector<float> values(pixelCount);
+	for (int i = 0; i < pixelCount; i++) values[i] = (ranks[i] + 0.5f) / pixelCount;
+	return values;
+}
+
+// The tile's value at (x, y), wrapping around at its edges.
+static float getBlueNoise(uint32_t x, uint32_t y) {
+	static const std::vector<float> tile = makeBlueNoise();
+	return tile[((y % BLUE_NOISE_SIZE) * BLUE_NOISE_SIZE) + (x % BLUE_NOISE_SIZE)];
+}
+
+glm::vec2 getSamplePoint(SamplingPattern pattern, const RandomStream& random, int sample, int count) {
+	glm::vec2 point;
+	switch (pattern) {
+	case UNIFORM_SAMPLING:
+		point = glm::vec2(random.get(sample, 0), random.get(sample, 1));
+		break;
+	case STRATIFIED_SAMPLING:
+	{
+		// Kensler's correlated multi-jittering: one point to each cell of a columns by rows grid, and one
+		// to each of the columns * rows slices across either axis, shuffled in the same way in every column.
+		uint32_t seed = random.getSeed(0);
+		int columns = std::max(1, (int)std::sqrt((float)count));
+		int rows = (count + columns - 1) / columns;
+		uint32_t cell = permute(sample, count, seed * 0x51633e2du);
+		uint32_t column = cell % columns;
+		uint32_t row = cell / columns;
+		uint32_t slotX = permute(row, rows, seed * 0x02e5be93u);
+		uint32_t slotY = permute(column, columns, seed * 0x68bc21ebu);
+		point.x = (column + ((slotX + random.get(sample, 0)) / rows)) / columns;
+		point.y = (row + ((slotY + random.get(sample, 1)) / columns)) / rows;
+		break;
+	}
+	case SOBOL_SAMPLING:
+	{
+		// The index is shuffled by an Owen scramble too, so each pixel uses a different run of points.
+		uint32_t x, y;
+		sobol(owenScramble(sample, random.getSeed(2)), x, y);
+		point = glm::vec2(toUnit(owenScramble(x, random.getSeed(0))), toUnit(owenScramble(y, random.getSeed(1))));
+		break;
+	}
+	case BLUE_NOISE_SAMPLING:
+	{
+		// Each coordinate reads the tile at its own offset, which changes from frame to frame.
+		uint32_t x, y;
+		sobol(owenScramble(sample, random.getFrameSeed(2)), x, y);
+		point = glm::vec2(toUnit(owenScramble(x, random.getFrameSeed(0))), toUnit(owenScramble(y, random.getFrameSeed(1))));
+		for (int d = 0; d < 2; d++) {
+			uint32_t offset = random.getFrameSeed(d + 3);
+			point[d] += getBlueNoise(random.getX() + (offset & 0xffff), random.getY() + (offset >> 16));
+			if (point[d] >= 1) point[d] -= 1;
+		}
+		break;
+	}
+	}
+	return point;
+}
\ No newline at end of file
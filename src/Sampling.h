@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <Random.h>
+
+// The width and height of the tile of blue noise that is repeated across the screen.
+#define BLUE_NOISE_SIZE 64
+
+// How the points an area light is sampled at are spread.
+enum SamplingPattern {
+	// Each point on its own, as if drawn with rand().
+	UNIFORM_SAMPLING,
+	// One point to each cell of a grid, and one to each slice of the square along either axis.
+	STRATIFIED_SAMPLING,
+	// A Sobol sequence with Owen scrambling, a different scramble for every pixel.
+	SOBOL_SAMPLING,
+	// The same Owen scrambled Sobol points for every pixel, shifted by a tile of blue noise so
+	// neighbouring pixels get very different shifts and what noise is left is fine grained.
+	BLUE_NOISE_SAMPLING
+};
+
+struct LightSampling {
+	SamplingPattern pattern;
+	// How many shadow rays a point sends to the area light.
+	int sampleCount;
+	// The most shadow rays GOURAUD and PHONG send from each vertex, up to MAX_LIGHT_SAMPLES. Scenes
+	// with more lights than this pick that many from the light tree by how much each could light the vertex.
+	int lightBudget;
+};
+
+// Point sample of count in the unit square, spread by the pattern, drawing its randomness from random.
+glm::vec2 getSamplePoint(SamplingPattern pattern, const RandomStream& random, int sample, int count);
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include <SceneCache.h>
+
+SceneCache::SceneCache() : weldedInstances(nullptr), weldedInstanceVersion(0), valid(false), buildCount(0), refitCount(0) {}
+
+bool SceneCache::update(const std::vector<ModelTriangle>& model, const InstanceSet& instances) {
+	if (valid && matches(model)) {
+		// Moving instances leaves the index valid, only new ones need welding.
+		if ((weldedInstances == &instances) && (weldedInstanceVersion == instances.getGeometryVersion())) return false;
+		weld(model, instances);
+		return true;
+	}
+
+	if (valid && (positions.size() == model.size() * 3) && bvh.refit(model)) {
+		geometry.update(model);
+		refitCount++;
+	}
+	else {
+		bvh = BVH(model);
+		geometry = TriangleStore(model, bvh.triangleIndices);
+		buildCount++;
+	}
+	positions.resize(model.size() * 3);
+	for (int i = 0; i < model.size(); i++) {
+		for (int j = 0; j < 3; j++) positions[(i * 3) + j] = model[i].vertices[j].position;
+	}
+	weld(model, instances);
+	valid = true;
+	return true;
+}
+
+void SceneCache::weld(const std::vector<ModelTriangle>& model, const InstanceSet& instances) {
+	vertexIndex.build(model, instances);
+	weldedInstances = &instances;
+	weldedInstanceVersion = instances.getGeometryVersion();
+}
+
+void SceneCache::invalidate() { valid = false; }
+
+SceneView SceneCache::getView(const std::vector<ModelTriangle>& model,
+	const InstanceSet& instances,
+	const std::vector<glm::vec3>& lights,
+	Camera cam) const {
+
+	SceneView scene = { model, geometry, lights, bvh, instances, cam };
+	scene.vertexIndex = &vertexIndex;
+	return scene;
+}
+
+int SceneCache::getBuildCount() const { return buildCount; }
+
+int SceneCache::getRefitCount() const { return refitCount; }
+
+// Comparing the positions costs far less than a rebuild, so it is done every frame rather than
+// trusting callers to report every change.
+bool SceneCache::matches(const std::vector<ModelTriangle>& model) const {
+	if (positions.size() != model.size() * 3) return false;
+	for (int i = 0; i < model.size(); i++) {
+		for (int j = 0; j < 3; j++) {
+			if (positions[(i * 3) + j] != model[i].vertices[j].position) return false;
+		}
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <ModelTriangle.h>
+#include <Objects.h>
+#include <BVH.h>
+#include <TriangleStore.h>
+#include <InstanceSet.h>
+#include <SceneView.h>
+#include <VertexLightCache.h>
+
+// Keeps the BVH and triangle store built from a model alive between frames. They only depend on
+// vertex positions, so changing materials or moving the camera leaves them valid and they are
+// only rebuilt when the geometry itself changes. Instances carry their own structures, adding
+// one never touches the model's. The vertex index GOURAUD and PHONG shadow is kept alongside,
+// welded again whenever the model is rebuilt or refitted or instances are added.
+class SceneCache {
+public:
+	SceneCache();
+	// Brings the cached structures up to date if the model's geometry differs from what they were
+	// built from. Moved vertices are refitted, new or removed triangles or a badly degraded refit
+	// cause a rebuild. Returns whether anything had to change. The instances should be the ones
+	// later passed to getView.
+	bool update(const std::vector<ModelTriangle>& model, const InstanceSet& instances);
+	// Forces the next update to rebuild, for callers that change the geometry in place.
+	void invalidate();
+	// A view of the model that carries the cached structures, call update first.
+	SceneView getView(const std::vector<ModelTriangle>& model,
+		const InstanceSet& instances,
+		const std::vector<glm::vec3>& lights,
+		Camera cam) const;
+	int getBuildCount() const;
+	int getRefitCount() const;
+
+private:
+	std::vector<glm::vec3> positions;
+	BVH bvh;
+	TriangleStore geometry;
+	VertexIndex vertexIndex;
+	// The instances the vertex index was welded with, and their geometry version at the time.
+	const InstanceSet* weldedInstances;
+	int weldedInstanceVersion;
+	bool valid;
+	int buildCount;
+	int refitCount;
+
+	bool matches(const std::vector<ModelTriangle>& model) const;
+	void weld(const std::vector<ModelTriangle>& model, const InstanceSet& instances);
+};
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <ModelTriangle.h>
+#include <Objects.h>
+#include <BVH.h>
+#include <TriangleStore.h>
+#include <InstanceSet.h>
+#include <Sampling.h>
+#include <LightTree.h>
+
+class VertexIndex;
+class VertexLightCache;
+class IrradianceCache;
+
+// Everything needed to shade a frame. It only refers to data owned elsewhere, so it is built
+// once per frame and handed down by const reference instead of copying the scene per ray.
+// Materials are reached through each triangle's material pointer.
+struct SceneView {
+	const std::vector<ModelTriangle>& triangles;
+	// Triangle positions in the layout the intersection kernel wants, in BVH leaf order when there is a BVH.
+	const TriangleStore& geometry;
+	const std::vector<glm::vec3>& lights;
+	const BVH& bvh;
+	const InstanceSet& instances;
+	Camera cam;
+	// Which frame of an animation this is, it keys the random numbers so each frame samples afresh.
+	uint32_t frame = 0;
+	// How AMBIENT spreads its shadow rays over the area light, and how many GOURAUD and PHONG send.
+	LightSampling lightSampling = { SOBOL_SAMPLING, 10, 32 };
+	// Every light GOURAUD and PHONG are shadowed by, which may be far more than lights. The renderers
+	// build one over lights when this is null.
+	const LightTree* lightTree = nullptr;
+	// Whether the renderers shadow each vertex once a frame for GOURAUD and PHONG, rather than at every pixel.
+	bool cacheVertexLighting = true;
+	// Which corners of the triangles are one vertex, kept by SceneCache. The renderers weld the scene's
+	// corners themselves when this is null or doesn't cover every triangle.
+	const VertexIndex* vertexIndex = nullptr;
+	// Vertex shadowing for the frame. The renderers shadow the vertices themselves when this is null and
+	// cacheVertexLighting is set, otherwise each pixel traces its own.
+	const VertexLightCache* vertexLighting = nullptr;
+	// Whether AMBIENT, GOURAUD and PHONG add the diffuse light bounced off other surfaces, in place of a constant.
+	bool indirectLighting = false;
+	// Records of the indirect light that outlive the frame. The renderers fill one of their own for the frame when this is null.
+	const IrradianceCache* irradianceCache = nullptr;
+
+	// The model's triangles come first and the instances' triangles are numbered after them.
+	int getTriangleCount() const { return triangles.size() + instances.getTriangleCount(); }
+	ModelTriangle getTriangle(int index) const {
+		if (index < triangles.size()) return triangles[index];
+		return instances.getTriangle(index - triangles.size());
+	}
+	IMaterial* getMaterial(int index) const {
+		if (index < triangles.size()) return triangles[index].material;
+		return instances.getMaterial(index - triangles.size());
+	}
+	glm::vec3 getNormal(int index) const {
+		if (index < triangles.size()) return triangles[index].normal;
+		return instances.getNormal(index - triangles.size());
+	}
+};
\ No newline at end of file
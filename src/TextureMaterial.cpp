@@ -1,6 +1,8 @@
 #include <TextureMaterial.h>
 #include <ModelTriangle.h>
 #include <Utilities.h>
+#include <SceneView.h>
+#include <RayTriangleIntersection.h>
 
 TextureMaterial::TextureMaterial(TextureMap texture) : texture(texture) {
 	recievesShadow = true;
@@ -8,18 +10,17 @@ TextureMaterial::TextureMaterial(TextureMap texture) : texture(texture) {
 
 TextureMaterial::~TextureMaterial() {}
 
-Colour TextureMaterial::GetColour(std::vector<ModelTriangle> model,
-	std::vector<glm::vec3> lights,
-	Camera cam,
+Colour TextureMaterial::GetColour(const SceneView& scene,
 	LightingMode lightingMode,
-	int triangleIndex, glm::vec3 point) {
-	ModelTriangle triangle = model[triangleIndex];
-	glm::vec2 texturePoint = triangleInterpolation(triangle.vertices[0].position,
-		triangle.vertices[1].position,
-		triangle.vertices[2].position,
-		triangle.vertices[0].texturePoint,
-		triangle.vertices[1].texturePoint,
-		triangle.vertices[2].texturePoint,
-		point);
+	const RayTriangleIntersection& intersection, RandomStream random) {
+	// The hit's barycentric weights are already the weights of each vertex's texture point.
+	ModelTriangle triangle = scene.getTriangle(intersection.triangleIndex);
+	glm::vec2 texturePoint = (triangle.vertices[0].texturePoint * (1 - intersection.u - intersection.v)) +
+		(triangle.vertices[1].texturePoint * intersection.u) +
+		(triangle.vertices[2].texturePoint * intersection.v);
 	return texture.GetValue(texturePoint);
+}
+
+const TextureMap* TextureMaterial::GetTexture() {
+	return &texture;
 }
\ No newline at end of file
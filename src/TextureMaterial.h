@@ -8,9 +8,8 @@ public:
 	TextureMap texture;
 	TextureMaterial(TextureMap texture);
 	virtual ~TextureMaterial();
-	virtual Colour GetColour(std::vector<ModelTriangle> model,
-		std::vector<glm::vec3> lights,
-		Camera cam,
+	virtual Colour GetColour(const SceneView& scene,
 		LightingMode lightingMode,
-		int triangleIndex, glm::vec3 point);
+		const RayTriangleIntersection& intersection, RandomStream random);
+	virtual const TextureMap* GetTexture();
 };
\ No newline at end of file
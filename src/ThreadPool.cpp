@@ -0,0 +1,128 @@
+#include <ThreadPool.h>
+#include <memory>
+#include <map>
+#include <algorithm>
+
+// The pool whose task the current thread is running, if any, and its index in that pool.
+static thread_local const ThreadPool* taskPool = nullptr;
+static thread_local int taskThreadIndex = 0;
+
+ThreadPool::ThreadPool(int threadCount) : queues(std::max(threadCount, 1)), currentTask(nullptr),
+	generation(0), busyWorkers(0), stopping(false), running(false) {
+	for (int i = 1; i < queues.size(); i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	startCondition.notify_all();
+	for (int i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+int ThreadPool::getThreadCount() const { return queues.size(); }
+
+void ThreadPool::run(int jobCount, const std::function<void(int, int)>& task) {
+	// Waiting here for the outer batch would never return, since it can't finish until this task does.
+	if (taskPool == this) {
+		for (int job = 0; job < jobCount; job++) task(job, taskThreadIndex);
+		return;
+	}
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		idleCondition.wait(lock, [this] { return !running; });
+		running = true;
+	}
+
+	// Jobs are dealt out in contiguous runs, so neighbouring jobs start on the same thread.
+	int threadCount = queues.size();
+	for (int i = 0; i < threadCount; i++) {
+		std::lock_guard<std::mutex> lock(queues[i].mutex);
+		int first = (jobCount * i) / threadCount;
+		int last = (jobCount * (i + 1)) / threadCount;
+		for (int job = first; job < last; job++) queues[i].jobs.push_back(job);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		currentTask = &task;
+		busyWorkers = workers.size();
+		generation++;
+	}
+	startCondition.notify_all();
+
+	work(0);
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+		currentTask = nullptr;
+		running = false;
+	}
+	idleCondition.notify_one();
+}
+
+void ThreadPool::workerLoop(int threadIndex) {
+	int seenGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			startCondition.wait(lock, [&] { return stopping || (generation != seenGeneration); });
+			if (stopping) return;
+			seenGeneration = generation;
+		}
+		work(threadIndex);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busyWorkers--;
+		}
+		doneCondition.notify_one();
+	}
+}
+
+// The calling thread may already be in a task of another pool, so that is put back afterwards.
+void ThreadPool::work(int threadIndex) {
+	const ThreadPool* outerPool = taskPool;
+	int outerThreadIndex = taskThreadIndex;
+	taskPool = this;
+	taskThreadIndex = threadIndex;
+	int job;
+	while (takeJob(threadIndex, job)) (*currentTask)(job, threadIndex);
+	taskPool = outerPool;
+	taskThreadIndex = outerThreadIndex;
+}
+
+bool ThreadPool::takeJob(int threadIndex, int& job) {
+	{
+		WorkQueue& own = queues[threadIndex];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty()) {
+			job = own.jobs.back();
+			own.jobs.pop_back();
+			return true;
+		}
+	}
+	for (int i = 1; i < queues.size(); i++) {
+		WorkQueue& victim = queues[(threadIndex + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.empty()) {
+			job = victim.jobs.front();
+			victim.jobs.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+ThreadPool& getThreadPool(int threadCount) {
+	static std::mutex poolsMutex;
+	static std::map<int, std::unique_ptr<ThreadPool>> pools;
+	threadCount = std::max(threadCount, 1);
+	std::lock_guard<std::mutex> lock(poolsMutex);
+	std::unique_ptr<ThreadPool>& pool = pools[threadCount];
+	if (!pool) pool.reset(new ThreadPool(threadCount));
+	return *pool;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// A fixed set of workers that run batches of numbered jobs. Each worker owns a queue and
+// takes jobs from its back, once it runs dry it steals from the front of the other queues.
+class ThreadPool {
+public:
+	ThreadPool(int threadCount);
+	~ThreadPool();
+	int getThreadCount() const;
+	// Calls task(jobIndex, threadIndex) for every job and returns once they have all finished.
+	// The calling thread joins in as thread 0. Only one batch runs on a pool at a time: a call from
+	// another thread waits for the running batch to finish, and a call from inside one of this pool's
+	// tasks runs its jobs on that task's thread, with that thread's index, before returning.
+	void run(int jobCount, const std::function<void(int, int)>& task);
+
+private:
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<int> jobs;
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<WorkQueue> queues;
+	const std::function<void(int, int)>* currentTask;
+	std::mutex mutex;
+	std::condition_variable startCondition;
+	std::condition_variable doneCondition;
+	std::condition_variable idleCondition;
+	int generation;
+	int busyWorkers;
+	bool stopping;
+	bool running;
+
+	void workerLoop(int threadIndex);
+	void work(int threadIndex);
+	bool takeJob(int threadIndex, int& job);
+};
+
+// Returns the pool shared by the renderers for the thread count, creating it the first time that
+// count is asked for. Each count keeps its own pool for the rest of the program, so changing the
+// count never pulls a pool out from under a caller that is still running on it. Per thread storage
+// should be sized with the pool's getThreadCount, which is at least 1 whatever count was asked for.
+ThreadPool& getThreadPool(int threadCount);
\ No newline at end of file
@@ -0,0 +1,309 @@
+#include <TriangleStore.h>
+#include <cstdint>
+#if TRIANGLE_LANES > 1
+#include <immintrin.h>
+#endif
+
+#define STORE_COMPONENTS 9
+#define STORE_ALIGNMENT 32
+
+TriangleStore::TriangleStore() : base(0), capacity(0) {}
+
+TriangleStore::TriangleStore(const std::vector<ModelTriangle>& model) : base(0), capacity(0) {
+	std::vector<int> order(model.size());
+	for (int i = 0; i < model.size(); i++) order[i] = i;
+	fill(model, order);
+}
+
+TriangleStore::TriangleStore(const std::vector<ModelTriangle>& model, const std::vector<int>& order) : base(0), capacity(0) {
+	fill(model, order);
+}
+
+TriangleStore::TriangleStore(const TriangleStore& other) : base(0), capacity(0) {
+	*this = other;
+}
+
+// The copied buffer can land on a different alignment, so the components are copied to a fresh base.
+TriangleStore& TriangleStore::operator=(const TriangleStore& other) {
+	if (this == &other) return *this;
+	allocate(other.capacity);
+	triangleIds = other.triangleIds;
+	std::copy(other.component(0), other.component(0) + (capacity * STORE_COMPONENTS), component(0));
+	return *this;
+}
+
+void TriangleStore::allocate(int slotCount) {
+	// Rounded up to whole blocks, with a spare block on the end so a block starting anywhere can be loaded.
+	capacity = ((slotCount + TRIANGLE_LANES - 1) / TRIANGLE_LANES) * TRIANGLE_LANES;
+	storage.assign((capacity * STORE_COMPONENTS) + TRIANGLE_LANES + (STORE_ALIGNMENT / sizeof(float)), 0.0f);
+	uintptr_t address = (uintptr_t)storage.data();
+	base = ((STORE_ALIGNMENT - (address % STORE_ALIGNMENT)) % STORE_ALIGNMENT) / sizeof(float);
+	triangleIds.assign(capacity + TRIANGLE_LANES, -1);
+}
+
+void TriangleStore::fill(const std::vector<ModelTriangle>& model, const std::vector<int>& order) {
+	allocate(order.size());
+	for (int slot = 0; slot < order.size(); slot++) triangleIds[slot] = order[slot];
+	update(model);
+}
+
+void TriangleStore::update(const std::vector<ModelTriangle>& model) {
+	for (int slot = 0; slot < capacity; slot++) {
+		if (triangleIds[slot] == -1) continue;
+		const ModelTriangle& triangle = model[triangleIds[slot]];
+		glm::vec3 v0 = triangle.vertices[0].position;
+		glm::vec3 e0 = triangle.vertices[1].position - v0;
+		glm::vec3 e1 = triangle.vertices[2].position - v0;
+		float values[STORE_COMPONENTS] = { v0.x, v0.y, v0.z, e0.x, e0.y, e0.z, e1.x, e1.y, e1.z };
+		for (int i = 0; i < STORE_COMPONENTS; i++) component(i)[slot] = values[i];
+	}
+}
+
+const float* TriangleStore::component(int index) const { return storage.data() + base + (index * capacity); }
+
+float* TriangleStore::component(int index) { return storage.data() + base + (index * capacity); }
+
+int TriangleStore::size() const { return capacity; }
+
+int TriangleStore::getTriangleIndex(int slot) const { return triangleIds[slot]; }
+
+TriangleEdges TriangleStore::getEdges(int slot) const {
+	TriangleEdges edges;
+	edges.v0 = glm::vec3(component(0)[slot], component(1)[slot], component(2)[slot]);
+	edges.e0 = glm::vec3(component(3)[slot], component(4)[slot], component(5)[slot]);
+	edges.e1 = glm::vec3(component(6)[slot], component(7)[slot], component(8)[slot]);
+	return edges;
+}
+
+// The SIMD kernels are Moller-Trumbore run across a block of triangles starting at slot. Lanes that
+// miss, are no nearer than maxDistance, are past end, are empty or are blacklisted get masked off.
+// Returns a bit per lane that hit, with the lanes' t, u and v written to the arrays.
+#if TRIANGLE_LANES == 8
+inline int TriangleStore::testBlock(const Ray& ray, int slot, int end, int indexBlacklist, float maxDistance,
+	float* ts, float* us, float* vs) const {
+
+	__m256 zero = _mm256_setzero_ps();
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256 dx = _mm256_set1_ps(ray.direction.x);
+	__m256 dy = _mm256_set1_ps(ray.direction.y);
+	__m256 dz = _mm256_set1_ps(ray.direction.z);
+	__m256 e0x = _mm256_loadu_ps(component(3) + slot);
+	__m256 e0y = _mm256_loadu_ps(component(4) + slot);
+	__m256 e0z = _mm256_loadu_ps(component(5) + slot);
+	__m256 e1x = _mm256_loadu_ps(component(6) + slot);
+	__m256 e1y = _mm256_loadu_ps(component(7) + slot);
+	__m256 e1z = _mm256_loadu_ps(component(8) + slot);
+
+	__m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e1z), _mm256_mul_ps(dz, e1y));
+	__m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e1x), _mm256_mul_ps(dx, e1z));
+	__m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e1y), _mm256_mul_ps(dy, e1x));
+	__m256 determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e0x, px), _mm256_mul_ps(e0y, py)), _mm256_mul_ps(e0z, pz));
+	__m256 inverseDeterminant = _mm256_div_ps(one, determinant);
+
+	__m256 sx = _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_loadu_ps(component(0) + slot));
+	__m256 sy = _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_loadu_ps(component(1) + slot));
+	__m256 sz = _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_loadu_ps(component(2) + slot));
+	__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), inverseDeterminant);
+
+	__m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e0z), _mm256_mul_ps(sz, e0y));
+	__m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e0x), _mm256_mul_ps(sx, e0z));
+	__m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e0y), _mm256_mul_ps(sy, e0x));
+	__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inverseDeterminant);
+	__m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, qx), _mm256_mul_ps(e1y, qy)), _mm256_mul_ps(e1z, qz)), inverseDeterminant);
+
+	__m256 mask = _mm256_cmp_ps(determinant, zero, _CMP_NEQ_OQ);
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, one, _CMP_LE_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, zero, _CMP_GT_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, _mm256_set1_ps(maxDistance), _CMP_LT_OQ));
+
+	__m256i ids = _mm256_loadu_si256((const __m256i*)(triangleIds.data() + slot));
+	__m256i rejected = _mm256_or_si256(_mm256_cmpeq_epi32(ids, _mm256_set1_epi32(indexBlacklist)), _mm256_cmpeq_epi32(ids, _mm256_set1_epi32(-1)));
+	__m256i inRange = _mm256_cmpgt_epi32(_mm256_set1_epi32(end - slot), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	mask = _mm256_and_ps(mask, _mm256_castsi256_ps(_mm256_andnot_si256(rejected, inRange)));
+
+	_mm256_storeu_ps(ts, t);
+	_mm256_storeu_ps(us, u);
+	_mm256_storeu_ps(vs, v);
+	return _mm256_movemask_ps(mask);
+}
+#elif TRIANGLE_LANES == 4
+inline int TriangleStore::testBlock(const Ray& ray, int slot, int end, int indexBlacklist, float maxDistance,
+	float* ts, float* us, float* vs) const {
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 dx = _mm_set1_ps(ray.direction.x);
+	__m128 dy = _mm_set1_ps(ray.direction.y);
+	__m128 dz = _mm_set1_ps(ray.direction.z);
+	__m128 e0x = _mm_loadu_ps(component(3) + slot);
+	__m128 e0y = _mm_loadu_ps(component(4) + slot);
+	__m128 e0z = _mm_loadu_ps(component(5) + slot);
+	__m128 e1x = _mm_loadu_ps(component(6) + slot);
+	__m128 e1y = _mm_loadu_ps(component(7) + slot);
+	__m128 e1z = _mm_loadu_ps(component(8) + slot);
+
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e1z), _mm_mul_ps(dz, e1y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e1x), _mm_mul_ps(dx, e1z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e1y), _mm_mul_ps(dy, e1x));
+	__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e0x, px), _mm_mul_ps(e0y, py)), _mm_mul_ps(e0z, pz));
+	__m128 inverseDeterminant = _mm_div_ps(one, determinant);
+
+	__m128 sx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_loadu_ps(component(0) + slot));
+	__m128 sy = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_loadu_ps(component(1) + slot));
+	__m128 sz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_loadu_ps(component(2) + slot));
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDeterminant);
+
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e0z), _mm_mul_ps(sz, e0y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e0x), _mm_mul_ps(sx, e0z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e0y), _mm_mul_ps(sy, e0x));
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDeterminant);
+	__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, qx), _mm_mul_ps(e1y, qy)), _mm_mul_ps(e1z, qz)), inverseDeterminant);
+
+	__m128 mask = _mm_cmpneq_ps(determinant, zero);
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+	mask = _mm_and_ps(mask, _mm_cmple_ps(u, one));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+	mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+	mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+	mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(maxDistance)));
+
+	__m128i ids = _mm_loadu_si128((const __m128i*)(triangleIds.data() + slot));
+	__m128i rejected = _mm_or_si128(_mm_cmpeq_epi32(ids, _mm_set1_epi32(indexBlacklist)), _mm_cmpeq_epi32(ids, _mm_set1_epi32(-1)));
+	__m128i inRange = _mm_cmpgt_epi32(_mm_set1_epi32(end - slot), _mm_setr_epi32(0, 1, 2, 3));
+	mask = _mm_and_ps(mask, _mm_castsi128_ps(_mm_andnot_si128(rejected, inRange)));
+
+	_mm_storeu_ps(ts, t);
+	_mm_storeu_ps(us, u);
+	_mm_storeu_ps(vs, v);
+	return _mm_movemask_ps(mask);
+}
+#endif
+
+bool TriangleStore::intersect(const Ray& ray, int first, int count, int indexBlacklist, TriangleHit& hit) const {
+	bool found = false;
+	int end = first + count;
+#if TRIANGLE_LANES > 1
+	// The nearest survivor of a block is taken in lane order, so ties go to the lower slot like the scalar loop.
+	float ts[TRIANGLE_LANES], us[TRIANGLE_LANES], vs[TRIANGLE_LANES];
+	for (int slot = first; slot < end; slot += TRIANGLE_LANES) {
+		int hits = testBlock(ray, slot, end, indexBlacklist, hit.t, ts, us, vs);
+		if (hits == 0) continue;
+		for (int lane = 0; lane < TRIANGLE_LANES; lane++) {
+			if (((hits >> lane) & 1) && (ts[lane] < hit.t)) {
+				hit.t = ts[lane];
+				hit.u = us[lane];
+				hit.v = vs[lane];
+				hit.triangleIndex = triangleIds[slot + lane];
+				found = true;
+			}
+		}
+	}
+#else
+	for (int slot = first; slot < end; slot++) {
+		int triangleIndex = triangleIds[slot];
+		if ((triangleIndex == -1) || (triangleIndex == indexBlacklist)) continue;
+		found |= intersectTriangle(ray, getEdges(slot), triangleIndex, hit);
+	}
+#endif
+	return found;
+}
+
+bool TriangleStore::occluded(const Ray& ray, int first, int count, int indexBlacklist, float maxDistance) const {
+	int end = first + count;
+#if TRIANGLE_LANES > 1
+	float ts[TRIANGLE_LANES], us[TRIANGLE_LANES], vs[TRIANGLE_LANES];
+	for (int slot = first; slot < end; slot += TRIANGLE_LANES) {
+		if (testBlock(ray, slot, end, indexBlacklist, maxDistance, ts, us, vs) != 0) return true;
+	}
+#else
+	for (int slot = first; slot < end; slot++) {
+		int triangleIndex = triangleIds[slot];
+		if ((triangleIndex == -1) || (triangleIndex == indexBlacklist)) continue;
+		TriangleHit hit = noHit(maxDistance);
+		if (intersectTriangle(ray, getEdges(slot), triangleIndex, hit)) return true;
+	}
+#endif
+	return false;
+}
+
+#if TRIANGLE_LANES == 8
+// The packet's rays share their origin, so everything that depends only on the origin and the
+// triangle is worked out once and only the direction terms are computed per lane.
+void TriangleStore::intersect(const RayPacket& packet, int first, int count, int laneMask, PacketHit& hits) const {
+	__m256 zero = _mm256_setzero_ps();
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	int end = first + count;
+	for (int slot = first; slot < end; slot++) {
+		int triangleIndex = triangleIds[slot];
+		if (triangleIndex == -1) continue;
+		TriangleEdges triangle = getEdges(slot);
+		glm::vec3 startToV0 = packet.origin - triangle.v0;
+		glm::vec3 q = glm::cross(startToV0, triangle.e0);
+		float tNumerator = glm::dot(triangle.e1, q);
+		__m256 e0x = _mm256_set1_ps(triangle.e0.x);
+		__m256 e0y = _mm256_set1_ps(triangle.e0.y);
+		__m256 e0z = _mm256_set1_ps(triangle.e0.z);
+		__m256 e1x = _mm256_set1_ps(triangle.e1.x);
+		__m256 e1y = _mm256_set1_ps(triangle.e1.y);
+		__m256 e1z = _mm256_set1_ps(triangle.e1.z);
+
+		for (int group = 0; group < PACKET_SIZE; group += 8) {
+			int groupMask = (laneMask >> group) & 0xFF;
+			if (groupMask == 0) continue;
+			__m256 dx = _mm256_loadu_ps(packet.directions[0] + group);
+			__m256 dy = _mm256_loadu_ps(packet.directions[1] + group);
+			__m256 dz = _mm256_loadu_ps(packet.directions[2] + group);
+			__m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e1z), _mm256_mul_ps(dz, e1y));
+			__m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e1x), _mm256_mul_ps(dx, e1z));
+			__m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e1y), _mm256_mul_ps(dy, e1x));
+			__m256 determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e0x, px), _mm256_mul_ps(e0y, py)), _mm256_mul_ps(e0z, pz));
+			__m256 inverseDeterminant = _mm256_div_ps(one, determinant);
+
+			__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(startToV0.x), px), _mm256_mul_ps(_mm256_set1_ps(startToV0.y), py)), _mm256_mul_ps(_mm256_set1_ps(startToV0.z), pz)), inverseDeterminant);
+			__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, _mm256_set1_ps(q.x)), _mm256_mul_ps(dy, _mm256_set1_ps(q.y))), _mm256_mul_ps(dz, _mm256_set1_ps(q.z))), inverseDeterminant);
+			__m256 t = _mm256_mul_ps(_mm256_set1_ps(tNumerator), inverseDeterminant);
+			__m256 closest = _mm256_loadu_ps(hits.t + group);
+
+			__m256 mask = _mm256_cmp_ps(determinant, zero, _CMP_NEQ_OQ);
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, one, _CMP_LE_OQ));
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, zero, _CMP_GT_OQ));
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, closest, _CMP_LT_OQ));
+			__m256i active = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(groupMask), laneBits), laneBits);
+			mask = _mm256_and_ps(mask, _mm256_castsi256_ps(active));
+			if (_mm256_movemask_ps(mask) == 0) continue;
+
+			_mm256_storeu_ps(hits.t + group, _mm256_blendv_ps(closest, t, mask));
+			_mm256_storeu_ps(hits.u + group, _mm256_blendv_ps(_mm256_loadu_ps(hits.u + group), u, mask));
+			_mm256_storeu_ps(hits.v + group, _mm256_blendv_ps(_mm256_loadu_ps(hits.v + group), v, mask));
+			__m256 indices = _mm256_castsi256_ps(_mm256_set1_epi32(triangleIndex));
+			__m256 previous = _mm256_loadu_ps((const float*)(hits.triangleIndex + group));
+			_mm256_storeu_ps((float*)(hits.triangleIndex + group), _mm256_blendv_ps(previous, indices, mask));
+		}
+	}
+}
+#else
+void TriangleStore::intersect(const RayPacket& packet, int first, int count, int laneMask, PacketHit& hits) const {
+	int end = first + count;
+	for (int slot = first; slot < end; slot++) {
+		int triangleIndex = triangleIds[slot];
+		if (triangleIndex == -1) continue;
+		TriangleEdges triangle = getEdges(slot);
+		for (int lane = 0; lane < PACKET_SIZE; lane++) {
+			if ((laneMask & (1 << lane)) == 0) continue;
+			TriangleHit hit = getPacketHit(hits, lane);
+			if (!intersectTriangle(packet.rays[lane], triangle, triangleIndex, hit)) continue;
+			hits.t[lane] = hit.t;
+			hits.u[lane] = hit.u;
+			hits.v[lane] = hit.v;
+			hits.triangleIndex[lane] = hit.triangleIndex;
+		}
+	}
+}
+#endif
\ No newline at end of file
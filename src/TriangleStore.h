@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <ModelTriangle.h>
+#include <Intersection.h>
+
+// How many triangles the intersection kernel tests at once. The watertight test has no SIMD
+// version, so it always runs one lane at a time.
+#if defined(WATERTIGHT_INTERSECTION)
+#define TRIANGLE_LANES 1
+#elif defined(__AVX2__)
+#define TRIANGLE_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TRIANGLE_LANES 4
+#else
+#define TRIANGLE_LANES 1
+#endif
+
+// Triangle positions as a structure of arrays. Each of v0.x, v0.y ... e1.z is its own aligned
+// float array, so the kernel reads TRIANGLE_LANES triangles per load and never touches the
+// normals, texture points and materials, which stay behind in the ModelTriangles.
+class TriangleStore {
+public:
+	TriangleStore();
+	// Stores the model in its own order.
+	TriangleStore(const std::vector<ModelTriangle>& model);
+	// Stores the triangles in the given order, a -1 leaves an empty slot that is never hit.
+	TriangleStore(const std::vector<ModelTriangle>& model, const std::vector<int>& order);
+	TriangleStore(const TriangleStore& other);
+	TriangleStore(TriangleStore&& other) = default;
+	TriangleStore& operator=(const TriangleStore& other);
+	TriangleStore& operator=(TriangleStore&& other) = default;
+	// Rewrites the positions of the stored triangles in place, for when the model's vertices move
+	// but its triangles stay the same.
+	void update(const std::vector<ModelTriangle>& model);
+	// The number of slots, including the padding at the end of the last block.
+	int size() const;
+	int getTriangleIndex(int slot) const;
+	TriangleEdges getEdges(int slot) const;
+	// Narrows hit down to the closest triangle in slots [first, first + count), returns whether it found one.
+	bool intersect(const Ray& ray, int first, int count, int indexBlacklist, TriangleHit& hit) const;
+	// Returns as soon as any triangle in the slots is hit closer than maxDistance.
+	bool occluded(const Ray& ray, int first, int count, int indexBlacklist, float maxDistance) const;
+	// Narrows each lane of hits set in laneMask down to the closest triangle in the slots. Each
+	// triangle is tested against the whole packet at once.
+	void intersect(const RayPacket& packet, int first, int count, int laneMask, PacketHit& hits) const;
+
+private:
+	std::vector<float> storage;
+	std::vector<int> triangleIds;
+	int base;
+	int capacity;
+
+	const float* component(int index) const;
+	float* component(int index);
+	void allocate(int slotCount);
+#if TRIANGLE_LANES > 1
+	int testBlock(const Ray& ray, int slot, int end, int indexBlacklist, float maxDistance, float* ts, float* us, float* vs) const;
+#endif
+	void fill(const std::vector<ModelTriangle>& model, const std::vector<int>& order);
+};
\ No newline at end of file
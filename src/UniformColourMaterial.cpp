@@ -1,5 +1,6 @@
 #include <UniformColourMaterial.h>
 #include <ModelTriangle.h>
+#include <SceneView.h>
 
 UniformColourMaterial::UniformColourMaterial(Colour colour) : colour(colour) {
 	recievesShadow = true;
@@ -7,10 +8,8 @@ UniformColourMaterial::UniformColourMaterial(Colour colour) : colour(colour) {
 
 UniformColourMaterial::~UniformColourMaterial() {}
 
-Colour UniformColourMaterial::GetColour(std::vector<ModelTriangle> model,
-	std::vector<glm::vec3> lights,
-	Camera cam,
+Colour UniformColourMaterial::GetColour(const SceneView& scene,
 	LightingMode lightingMode,
-	int triangleIndex, glm::vec3 point) {
+	const RayTriangleIntersection& intersection, RandomStream random) {
 	return colour;
 }
\ No newline at end of file
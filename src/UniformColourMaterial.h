@@ -7,9 +7,7 @@ class UniformColourMaterial : public IMaterial {
 		Colour colour;
 		UniformColourMaterial(Colour colour);
 		virtual ~UniformColourMaterial();
-		virtual Colour GetColour(std::vector<ModelTriangle> model,
-			std::vector<glm::vec3> lights,
-			Camera cam,
+		virtual Colour GetColour(const SceneView& scene,
 			LightingMode lightingMode,
-			int triangleIndex, glm::vec3 point);
+			const RayTriangleIntersection& intersection, RandomStream random);
 };
\ No newline at end of file
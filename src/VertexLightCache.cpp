@@ -0,0 +1,89 @@
+#include <VertexLightCache.h>
+#include <Raytracing.h>
+#include <ThreadPool.h>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// Vertices draw their random numbers from a row of streams that no pixel is on.
+#define VERTEX_STREAM_ROW 0xffffffffu
+
+bool shadesVertices(LightingMode lightingMode) {
+	return (lightingMode == GOURAUD) || (lightingMode == PHONG) || (lightingMode == AMBIENT);
+}
+
+// Hashes the bits of the position, only corners at exactly the same place count as one vertex. The
+// map compares positions with ==, so -0 is made +0 first to hash the same as the +0 it equals.
+struct PositionHash {
+	size_t operator()(const glm::vec3& position) const {
+		glm::vec3 canonical = position + 0.0f;
+		uint32_t bits[3];
+		std::memcpy(bits, &canonical, sizeof(bits));
+		return hashRandom(bits[0] + hashRandom(bits[1] + hashRandom(bits[2])));
+	}
+};
+
+VertexIndex::VertexIndex() {}
+
+void VertexIndex::build(const std::vector<ModelTriangle>& model, const InstanceSet& instances) {
+	triangleVertices.resize(model.size() + instances.getTriangleCount());
+	corners.clear();
+	weld(model, 0);
+	for (int i = 0; i < instances.getInstanceCount(); i++) {
+		const MeshInstance& instance = instances.getInstance(i);
+		weld(instances.getMeshTriangles(instance.mesh), model.size() + instance.firstIndex);
+	}
+}
+
+// Welds the triangles among themselves only, a vertex is never shared with anything welded before.
+void VertexIndex::weld(const std::vector<ModelTriangle>& triangles, int firstTriangle) {
+	std::unordered_map<glm::vec3, int, PositionHash> vertexIndices;
+	vertexIndices.reserve(triangles.size());
+	for (int i = 0; i < triangles.size(); i++) {
+		for (int j = 0; j < 3; j++) {
+			auto inserted = vertexIndices.insert(std::make_pair(triangles[i].vertices[j].position, (int)corners.size()));
+			if (inserted.second) corners.push_back(((firstTriangle + i) * 3) + j);
+			triangleVertices[firstTriangle + i][j] = inserted.first->second;
+		}
+	}
+}
+
+int VertexIndex::getVertexCount() const { return corners.size(); }
+
+int VertexIndex::getTriangleCount() const { return triangleVertices.size(); }
+
+const std::array<int, 3>& VertexIndex::getVertices(int triangleIndex) const { return triangleVertices[triangleIndex]; }
+
+glm::vec3 VertexIndex::getPosition(const SceneView& scene, int vertex) const {
+	int triangleIndex = corners[vertex] / 3;
+	int corner = corners[vertex] % 3;
+	if (triangleIndex < scene.triangles.size()) return scene.triangles[triangleIndex].vertices[corner].position;
+	return scene.instances.getTriangle(triangleIndex - scene.triangles.size()).vertices[corner].position;
+}
+
+VertexLightCache::VertexLightCache() : index(nullptr) {}
+
+// The shadow rays start a little way towards their light, so they don't need a triangle left out
+// to miss the ones the vertex sits on. None is left out, as a vertex belongs to every triangle
+// around it and leaving out just one would treat it differently from the rest.
+void VertexLightCache::light(const SceneView& scene, const VertexIndex& index, int threadCount) {
+	this->index = &index;
+	int vertexCount = index.getVertexCount();
+	brightnesses.resize(vertexCount);
+	ThreadPool& pool = getThreadPool(threadCount);
+	int jobCount = (vertexCount + VERTEX_LIGHTING_JOB_SIZE - 1) / VERTEX_LIGHTING_JOB_SIZE;
+	pool.run(jobCount, [&](int jobIndex, int threadIndex) {
+		ShadowRayTracer shadowRays;
+		int end = std::min(vertexCount, (jobIndex + 1) * VERTEX_LIGHTING_JOB_SIZE);
+		for (int i = jobIndex * VERTEX_LIGHTING_JOB_SIZE; i < end; i++) {
+			RandomStream random = RandomStream(scene.frame, i, VERTEX_STREAM_ROW);
+			brightnesses[i] = unblockedLight(index.getPosition(scene, i), std::numeric_limits<int>::max(), scene, shadowRays, random, 0);
+		}
+	});
+}
+
+glm::vec3 VertexLightCache::getBrightnesses(int triangleIndex) const {
+	const std::array<int, 3>& vertices = index->getVertices(triangleIndex);
+	return glm::vec3(brightnesses[vertices[0]], brightnesses[vertices[1]], brightnesses[vertices[2]]);
+}
\ No newline at end of file
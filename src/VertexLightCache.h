@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <glm/glm.hpp>
+#include <ModelTriangle.h>
+#include <Objects.h>
+#include <InstanceSet.h>
+#include <SceneView.h>
+
+// How many vertices one thread pool job shadows.
+#define VERTEX_LIGHTING_JOB_SIZE 256
+
+// Whether shading in lightingMode reads the shadowing at triangles' vertices. AMBIENT shades
+// everything past the box as PHONG does.
+bool shadesVertices(LightingMode lightingMode);
+
+// Which corners of a scene's triangles are one vertex. Corners of the model's triangles at exactly
+// the same position are one vertex, and so are corners at exactly the same position within one
+// instance, so moving an instance never changes which corners are welded. It only depends on the
+// geometry, so SceneCache keeps one alive between frames and welds again when the geometry changes.
+class VertexIndex {
+public:
+	VertexIndex();
+	// Welds the corners of the model's triangles and of every instance's, numbered as SceneView numbers them.
+	void build(const std::vector<ModelTriangle>& model, const InstanceSet& instances);
+	int getVertexCount() const;
+	int getTriangleCount() const;
+	const std::array<int, 3>& getVertices(int triangleIndex) const;
+	// Where the vertex is in the scene this frame, which may have moved its instances since the index was built.
+	glm::vec3 getPosition(const SceneView& scene, int vertex) const;
+
+private:
+	std::vector<std::array<int, 3>> triangleVertices;
+	// The first corner found at each vertex, as triangleIndex * 3 + corner.
+	std::vector<int> corners;
+
+	void weld(const std::vector<ModelTriangle>& triangles, int firstTriangle);
+};
+
+// The share of light reaching every vertex in the scene, for GOURAUD and PHONG to blend across
+// each triangle. A vertex shared by several triangles, and seen by thousands of pixels, is shadowed
+// once a frame.
+class VertexLightCache {
+public:
+	VertexLightCache();
+	// Shadows every vertex of index against the scene's lights, spread over the pool's threads. The
+	// index has to cover the scene's triangles and outlive the cache's use.
+	void light(const SceneView& scene, const VertexIndex& index, int threadCount);
+	// The brightness at each corner of the triangle with the given index, from the last call to light.
+	glm::vec3 getBrightnesses(int triangleIndex) const;
+
+private:
+	const VertexIndex* index;
+	std::vector<float> brightnesses;
+};
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include <Wavefront.h>
+#include <Raytracing.h>
+#include <RayTriangleIntersection.h>
+#include <ThreadPool.h>
+#include <FrameScene.h>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+
+// How many rays or pixels one thread pool job handles.
+#define WAVEFRONT_JOB_SIZE 256
+
+struct QueuedRay {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float maxDistance;
+	int indexBlacklist;
+};
+
+// A pixel on its way through the pipeline.
+struct WavefrontPath {
+	int pixel;
+	RandomStream random;
+	RayTriangleIntersection hit;
+	// Set when the hit's material shows a reflection, reflectionHit is then what it shows.
+	bool reflects;
+	RayTriangleIntersection reflectionHit;
+	// The path's shadow rays are queued from here on, the hit's first and then the reflected surface's.
+	int firstShadowRay;
+};
+
+// Queues every shadow ray it is asked about and answers that nothing is in the way for now.
+class ShadowRayRecorder : public ShadowRayTracer {
+public:
+	std::vector<QueuedRay> queue;
+
+	bool isOccluded(glm::vec3 startPosition, glm::vec3 direction, float maxDistance, const SceneView& scene, int indexBlacklist) {
+		queue.push_back({ startPosition, direction, maxDistance, indexBlacklist });
+		return false;
+	}
+};
+
+// Answers with the traced results, in the order the rays were recorded.
+class ShadowRayReplay : public ShadowRayTracer {
+public:
+	ShadowRayReplay(const std::vector<char>& blocked, int next) : blocked(blocked), next(next) {}
+
+	bool isOccluded(glm::vec3 startPosition, glm::vec3 direction, float maxDistance, const SceneView& scene, int indexBlacklist) {
+		return blocked[next++] != 0;
+	}
+
+private:
+	const std::vector<char>& blocked;
+	int next;
+};
+
+// Bits of each origin coordinate in the sort key, on top of the three octant bits.
+#define SORT_BITS_PER_AXIS 4
+
+// Spreads the low SORT_BITS_PER_AXIS bits of x out to every third bit.
+static uint32_t spreadBits(uint32_t x) {
+	uint32_t spread = 0;
+	for (int bit = 0; bit < SORT_BITS_PER_AXIS; bit++) spread |= ((x >> bit) & 1) << (3 * bit);
+	return spread;
+}
+
+// The order to trace the rays in. Rays heading into the same octant go together and within an
+// octant they follow the Morton order of their origins on a coarse grid, so neighbouring rays
+// walk the same nodes. A counting sort keeps it linear in the number of rays and stable.
+static std::vector<int> sortRays(const std::vector<QueuedRay>& rays) {
+	glm::vec3 lower = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 upper = glm::vec3(-std::numeric_limits<float>::max());
+	for (int i = 0; i < rays.size(); i++) {
+		lower = glm::min(lower, rays[i].origin);
+		upper = glm::max(upper, rays[i].origin);
+	}
+	float cells = (1 << SORT_BITS_PER_AXIS) - 1;
+	glm::vec3 scale = cells / glm::max(upper - lower, glm::vec3(std::numeric_limits<float>::min()));
+
+	std::vector<uint32_t> keys(rays.size());
+	std::vector<int> bucketStarts((8 << (3 * SORT_BITS_PER_AXIS)) + 1, 0);
+	for (int i = 0; i < rays.size(); i++) {
+		glm::vec3 direction = rays[i].direction;
+		uint32_t octant = (direction.x < 0 ? 1 : 0) | (direction.y < 0 ? 2 : 0) | (direction.z < 0 ? 4 : 0);
+		glm::vec3 cell = (rays[i].origin - lower) * scale;
+		uint32_t morton = spreadBits((uint32_t)cell.x) | (spreadBits((uint32_t)cell.y) << 1) | (spreadBits((uint32_t)cell.z) << 2);
+		keys[i] = (octant << (3 * SORT_BITS_PER_AXIS)) | morton;
+		bucketStarts[keys[i] + 1]++;
+	}
+	for (int i = 1; i < bucketStarts.size(); i++) bucketStarts[i] += bucketStarts[i - 1];
+
+	std::vector<int> order(rays.size());
+	for (int i = 0; i < rays.size(); i++) {
+		order[bucketStarts[keys[i]]] = i;
+		bucketStarts[keys[i]]++;
+	}
+	return order;
+}
+
+// Calls work(order[i]) for every i, split into jobs across the pool.
+static void runInOrder(ThreadPool& pool, const std::vector<int>& order, const std::function<void(int)>& work) {
+	int jobCount = (order.size() + WAVEFRONT_JOB_SIZE - 1) / WAVEFRONT_JOB_SIZE;
+	pool.run(jobCount, [&](int jobIndex, int threadIndex) {
+		int end = std::min((int)order.size(), (jobIndex + 1) * WAVEFRONT_JOB_SIZE);
+		for (int i = jobIndex * WAVEFRONT_JOB_SIZE; i < end; i++) work(order[i]);
+	});
+}
+
+static bool showsReflection(const WavefrontPath& path, const SceneView& scene) {
+	return path.reflects &&
+		(path.reflectionHit.distance < std::numeric_limits<float>::max()) &&
+		getMaterial(path.reflectionHit, scene)->recievesShadow;
+}
+
+// Asks for the same brightnesses, in the same order, as shadePath, so the shadow rays queued here
+// are the ones shadePath is answered with.
+static void recordShadowRays(const WavefrontPath& path, const SceneView& scene, LightingMode lightingMode, ShadowRayRecorder& recorder) {
+	RandomStream random = path.random;
+	if (getMaterial(path.hit, scene)->recievesShadow) calculateBrightness(path.hit, lightingMode, scene, recorder, random);
+	if (showsReflection(path, scene)) calculateBrightness(path.reflectionHit, lightingMode, scene, recorder, random.bounce());
+}
+
+// The same arithmetic as shading a pixel in rayTracedRender, with MirrorMaterial::GetColour's
+// reflection already traced.
+static uint32_t shadePath(const WavefrontPath& path, const SceneView& scene, LightingMode lightingMode, const std::vector<char>& blocked) {
+	ShadowRayReplay shadowRays(blocked, path.firstShadowRay);
+	RandomStream random = path.random;
+	const RayTriangleIntersection& hit = path.hit;
+	IMaterial* material = getMaterial(hit, scene);
+	glm::vec3 lighting = glm::vec3(1, 1, 1);
+	if (material->recievesShadow)
+		lighting = calculateLighting(hit, lightingMode, scene, shadowRays, random);
+
+	Colour colour;
+	if (hit.distance == std::numeric_limits<float>::max()) {
+		colour = Colour(0, 0, 0);
+	}
+	else {
+		if (path.reflects) {
+			colour = Colour(0, 0, 0);
+			if (showsReflection(path, scene)) {
+				const RayTriangleIntersection& reflected = path.reflectionHit;
+				glm::vec3 brightness = calculateLighting(reflected, lightingMode, scene, shadowRays, random.bounce());
+				colour = material->ShadeReflection(getMaterial(reflected, scene)->GetColour(scene, lightingMode,
+					reflected, random.bounce()), brightness);
+			}
+		}
+		else {
+			colour = material->GetColour(scene, lightingMode, hit, random);
+		}
+		colour.red *= lighting.r;
+		colour.blue *= lighting.b;
+		colour.green *= lighting.g;
+	}
+	return colour.getPackedColour();
+}
+
+WavefrontStats wavefrontRender(const SceneView& worldScene,
+	DrawingWindow& window,
+	LightingMode lightingMode,
+	int threadCount,
+	int batchSize) {
+
+	FrameScene frameScene(worldScene, window, lightingMode, threadCount);
+	const SceneView& scene = frameScene.getView();
+	glm::mat3 cameraToWorld = glm::inverse(scene.cam.orientation);
+
+	ThreadPool& pool = getThreadPool(threadCount);
+	WavefrontStats stats = { 0, 0, 0 };
+	int pixelCount = window.width * window.height;
+	std::vector<WavefrontPath> paths;
+	std::vector<QueuedRay> reflectionRays;
+	std::vector<int> reflectionPaths;
+	std::vector<QueuedRay> shadowRays;
+	std::vector<char> blocked;
+	std::vector<ShadowRayRecorder> recorders;
+
+	// Batches are whole bands of packet rows, so the camera rays can be traced as packets like rayTracedRender's.
+	int bandPixels = window.width * PACKET_HEIGHT;
+	batchSize = std::max(1, batchSize / bandPixels) * bandPixels;
+	int packetsAcross = (window.width + PACKET_WIDTH - 1) / PACKET_WIDTH;
+	for (int batchStart = 0; batchStart < pixelCount; batchStart += batchSize) {
+		int batchCount = std::min(batchSize, pixelCount - batchStart);
+		int batchTop = batchStart / window.width;
+		int batchRows = batchCount / window.width;
+
+		// Camera rays, already coherent within each packet, so they skip the sort.
+		paths.resize(batchCount);
+		int packetCount = packetsAcross * ((batchRows + PACKET_HEIGHT - 1) / PACKET_HEIGHT);
+		pool.run((packetCount + WAVEFRONT_JOB_SIZE - 1) / WAVEFRONT_JOB_SIZE, [&](int jobIndex, int threadIndex) {
+			RayTriangleIntersection intersections[PACKET_SIZE];
+			int end = std::min(packetCount, (jobIndex + 1) * WAVEFRONT_JOB_SIZE);
+			for (int packetIndex = jobIndex * WAVEFRONT_JOB_SIZE; packetIndex < end; packetIndex++) {
+				int x = (packetIndex % packetsAcross) * PACKET_WIDTH;
+				int y = (packetIndex / packetsAcross) * PACKET_HEIGHT;
+				int width = std::min(PACKET_WIDTH, window.width - x);
+				int height = std::min(PACKET_HEIGHT, batchRows - y);
+				getCameraHits(x, batchTop + y, width, height, scene, cameraToWorld, window, intersections);
+				for (int lane = 0; lane < width * height; lane++) {
+					WavefrontPath& path = paths[((y + (lane / width)) * window.width) + x + (lane % width)];
+					path.pixel = batchStart + ((y + (lane / width)) * window.width) + x + (lane % width);
+					path.random = RandomStream(scene.frame, x + (lane % width), batchTop + y + (lane / width));
+					path.hit = intersections[lane];
+					path.reflects = false;
+				}
+			}
+		});
+
+		// From here on the paths are handled grouped by the material they hit.
+		std::vector<std::pair<IMaterial*, int>> materialKeys(batchCount);
+		for (int i = 0; i < batchCount; i++) materialKeys[i] = std::make_pair(getMaterial(paths[i].hit, scene), i);
+		std::sort(materialKeys.begin(), materialKeys.end(), [](const std::pair<IMaterial*, int>& a, const std::pair<IMaterial*, int>& b) {
+			return std::less<IMaterial*>()(a.first, b.first) || ((a.first == b.first) && (a.second < b.second));
+		});
+		std::vector<int> byMaterial(batchCount);
+		for (int i = 0; i < batchCount; i++) byMaterial[i] = materialKeys[i].second;
+
+		// Reflection rays.
+		reflectionRays.clear();
+		reflectionPaths.clear();
+		for (int i = 0; i < batchCount; i++) {
+			WavefrontPath& path = paths[byMaterial[i]];
+			if (path.hit.distance == std::numeric_limits<float>::max()) continue;
+			glm::vec3 direction;
+			if (!getMaterial(path.hit, scene)->GetReflection(scene, path.hit.triangleIndex, path.hit.intersectionPoint, direction)) continue;
+			path.reflects = true;
+			reflectionRays.push_back({ path.hit.intersectionPoint, direction, std::numeric_limits<float>::max(), (int)path.hit.triangleIndex });
+			reflectionPaths.push_back(byMaterial[i]);
+		}
+		runInOrder(pool, sortRays(reflectionRays), [&](int i) {
+			const QueuedRay& ray = reflectionRays[i];
+			paths[reflectionPaths[i]].reflectionHit = getClosestIntersection(ray.origin, ray.direction, scene, ray.indexBlacklist);
+		});
+
+		// Shadow rays. Each job queues its own, then the queues are joined in job order so the
+		// result doesn't depend on which thread ran which job.
+		int jobCount = (batchCount + WAVEFRONT_JOB_SIZE - 1) / WAVEFRONT_JOB_SIZE;
+		recorders.resize(jobCount);
+		pool.run(jobCount, [&](int jobIndex, int threadIndex) {
+			ShadowRayRecorder& recorder = recorders[jobIndex];
+			recorder.queue.clear();
+			int end = std::min(batchCount, (jobIndex + 1) * WAVEFRONT_JOB_SIZE);
+			for (int i = jobIndex * WAVEFRONT_JOB_SIZE; i < end; i++) {
+				WavefrontPath& path = paths[byMaterial[i]];
+				path.firstShadowRay = recorder.queue.size();
+				recordShadowRays(path, scene, lightingMode, recorder);
+			}
+		});
+		shadowRays.clear();
+		for (int job = 0; job < jobCount; job++) {
+			int end = std::min(batchCount, (job + 1) * WAVEFRONT_JOB_SIZE);
+			for (int i = job * WAVEFRONT_JOB_SIZE; i < end; i++) paths[byMaterial[i]].firstShadowRay += shadowRays.size();
+			shadowRays.insert(shadowRays.end(), recorders[job].queue.begin(), recorders[job].queue.end());
+		}
+		blocked.resize(shadowRays.size());
+		runInOrder(pool, sortRays(shadowRays), [&](int i) {
+			const QueuedRay& ray = shadowRays[i];
+			blocked[i] = occluded(ray.origin, ray.direction, ray.maxDistance, scene, ray.indexBlacklist) ? 1 : 0;
+		});
+
+		// Shading, still grouped by material.
+		runInOrder(pool, byMaterial, [&](int i) {
+			const WavefrontPath& path = paths[i];
+			window.setPixelColour(path.pixel % window.width, path.pixel / window.width, shadePath(path, scene, lightingMode, blocked));
+		});
+
+		stats.cameraRays += batchCount;
+		stats.reflectionRays += reflectionRays.size();
+		stats.shadowRays += shadowRays.size();
+	}
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <DrawingWindow.h>
+#include <Objects.h>
+#include <SceneView.h>
+
+// How many pixels go through the pipeline together, each stage works on the whole batch before
+// the next starts. It is rounded down to whole bands of packet rows.
+#define WAVEFRONT_BATCH_SIZE 5120
+
+// How many rays of each kind the last wavefront frame traced.
+struct WavefrontStats {
+	long long cameraRays;
+	long long reflectionRays;
+	long long shadowRays;
+};
+
+// Renders the same image as rayTracedRender, but stage by stage instead of pixel by pixel. The
+// camera rays of a batch are traced in packets, then the hits are grouped by material and the
+// reflection and shadow rays they need are queued. Those queues are sorted by direction octant
+// and origin before they are traced, and the pixels are only shaded once every ray is answered.
+WavefrontStats wavefrontRender(const SceneView& scene,
+	DrawingWindow& window,
+	LightingMode lightingMode,
+	int threadCount = 1,
+	int batchSize = WAVEFRONT_BATCH_SIZE);
\ No newline at end of file
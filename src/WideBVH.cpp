@@ -0,0 +1,254 @@
+#include <WideBVH.h>
+#include <BVH.h>
+#include <cmath>
+#include <cstring>
+#if WIDE_BVH_WIDTH == 8 && defined(__AVX2__)
+#define WIDE_BVH_AVX2
+#include <immintrin.h>
+#elif WIDE_BVH_WIDTH == 4 && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define WIDE_BVH_SSE
+#include <emmintrin.h>
+#endif
+
+WideBVH::WideBVH() {}
+
+WideBVH::WideBVH(const BVH& bvh) {
+	if (bvh.isEmpty()) return;
+	// Every wide node absorbs at least one binary interior node.
+	nodes.reserve(bvh.nodes.size() / 2 + 1);
+	collapse(bvh, 0);
+}
+
+bool WideBVH::isEmpty() const { return nodes.empty(); }
+
+// Builds the wide node for a binary node and everything below it, returns its index.
+int WideBVH::collapse(const BVH& bvh, int binaryIndex) {
+	const BVHNode& binary = bvh.nodes[binaryIndex];
+	std::vector<int> children;
+	if (binary.count > 0) children.push_back(binaryIndex);
+	else {
+		children.push_back(binary.leftFirst);
+		children.push_back(binary.leftFirst + 1);
+	}
+	// Keep opening the largest interior child, it is the one most rays reach, until the node is full.
+	while (children.size() < WIDE_BVH_WIDTH) {
+		int largest = -1;
+		float largestArea = -1;
+		for (int i = 0; i < children.size(); i++) {
+			const BVHNode& child = bvh.nodes[children[i]];
+			if ((child.count == 0) && (child.bounds.surfaceArea() > largestArea)) {
+				largest = i;
+				largestArea = child.bounds.surfaceArea();
+			}
+		}
+		if (largest == -1) break;
+		int opened = children[largest];
+		children[largest] = bvh.nodes[opened].leftFirst;
+		children.push_back(bvh.nodes[opened].leftFirst + 1);
+	}
+
+	WideBVHNode node;
+	const AABB& parent = binary.bounds;
+	node.origin = parent.min;
+	for (int axis = 0; axis < 3; axis++) {
+		// A step is never narrower than a few floats apart at this distance from the origin, so the
+		// one step of padding on each child below covers the rounding in the slab test.
+		float magnitude = std::max(std::abs(parent.min[axis]), std::abs(parent.max[axis]));
+		float scale = std::max((parent.max[axis] - parent.min[axis]) / QUANTIZED_PLANE_MAX, magnitude * 8 * std::numeric_limits<float>::epsilon());
+		while (node.origin[axis] + (scale * QUANTIZED_PLANE_MAX) < parent.max[axis]) scale = std::nextafter(scale, std::numeric_limits<float>::max());
+		node.scale[axis] = scale;
+	}
+
+	for (int i = 0; i < WIDE_BVH_WIDTH; i++) {
+		node.children[i] = 0;
+		node.counts[i] = -1;
+		for (int axis = 0; axis < 3; axis++) {
+			node.lower[axis][i] = 0;
+			node.upper[axis][i] = 0;
+		}
+		if (i >= children.size()) continue;
+
+		const BVHNode& child = bvh.nodes[children[i]];
+		for (int axis = 0; axis < 3; axis++) {
+			float scale = node.scale[axis];
+			if (scale == 0) {
+				node.upper[axis][i] = QUANTIZED_PLANE_MAX;
+				continue;
+			}
+			// Round outwards and pad by a step so the stored box always contains the real one.
+			float lower = std::floor((child.bounds.min[axis] - node.origin[axis]) / scale) - 1;
+			float upper = std::ceil((child.bounds.max[axis] - node.origin[axis]) / scale) + 1;
+			node.lower[axis][i] = (QuantizedPlane)std::min(std::max(lower, 0.0f), (float)QUANTIZED_PLANE_MAX);
+			node.upper[axis][i] = (QuantizedPlane)std::min(std::max(upper, 0.0f), (float)QUANTIZED_PLANE_MAX);
+		}
+		node.counts[i] = child.count;
+		node.children[i] = child.leftFirst;
+	}
+
+	int nodeIndex = nodes.size();
+	nodes.push_back(node);
+	// Collapsing the children grows the node list, so the interior links are filled in by index afterwards.
+	for (int i = 0; i < children.size(); i++) {
+		if (bvh.nodes[children[i]].count == 0) {
+			int childIndex = collapse(bvh, children[i]);
+			nodes[nodeIndex].children[i] = childIndex;
+		}
+	}
+	return nodeIndex;
+}
+
+#if defined(WIDE_BVH_AVX2)
+static inline __m256 loadPlanes(const QuantizedPlane* planes) {
+#if WIDE_BVH_BITS == 16
+	return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)planes)));
+#else
+	return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)planes)));
+#endif
+}
+
+// One slab test for all eight children, with the planes widened from their quantized steps in registers.
+int WideBVH::intersectChildren(const WideBVHNode& node, const Ray& ray, float maxDistance, float* distances) const {
+	__m256 entry = _mm256_setzero_ps();
+	__m256 exit = _mm256_set1_ps(maxDistance);
+	for (int axis = 0; axis < 3; axis++) {
+		__m256 offset = _mm256_set1_ps(node.origin[axis] - ray.origin[axis]);
+		__m256 scale = _mm256_set1_ps(node.scale[axis]);
+		__m256 inverseDirection = _mm256_set1_ps(ray.inverseDirection[axis]);
+		__m256 t0 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(loadPlanes(node.lower[axis]), scale), offset), inverseDirection);
+		__m256 t1 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(loadPlanes(node.upper[axis]), scale), offset), inverseDirection);
+		// The running entry and exit go second, so a NaN from a ray lying in a plane is ignored.
+		entry = _mm256_max_ps(_mm256_min_ps(t0, t1), entry);
+		exit = _mm256_min_ps(_mm256_max_ps(t0, t1), exit);
+	}
+	__m256i counts = _mm256_loadu_si256((const __m256i*)node.counts);
+	__m256 empty = _mm256_castsi256_ps(_mm256_cmpeq_epi32(counts, _mm256_set1_epi32(-1)));
+	_mm256_storeu_ps(distances, entry);
+	return _mm256_movemask_ps(_mm256_andnot_ps(empty, _mm256_cmp_ps(entry, exit, _CMP_LE_OQ)));
+}
+#elif defined(WIDE_BVH_SSE)
+static inline __m128 loadPlanes(const QuantizedPlane* planes) {
+	__m128i zero = _mm_setzero_si128();
+#if WIDE_BVH_BITS == 16
+	__m128i words = _mm_loadl_epi64((const __m128i*)planes);
+#else
+	int bytes;
+	std::memcpy(&bytes, planes, sizeof(bytes));
+	__m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero);
+#endif
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+}
+
+// The same test as the AVX2 one, for four children at a time.
+int WideBVH::intersectChildren(const WideBVHNode& node, const Ray& ray, float maxDistance, float* distances) const {
+	__m128 entry = _mm_setzero_ps();
+	__m128 exit = _mm_set1_ps(maxDistance);
+	for (int axis = 0; axis < 3; axis++) {
+		__m128 offset = _mm_set1_ps(node.origin[axis] - ray.origin[axis]);
+		__m128 scale = _mm_set1_ps(node.scale[axis]);
+		__m128 inverseDirection = _mm_set1_ps(ray.inverseDirection[axis]);
+		__m128 t0 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(loadPlanes(node.lower[axis]), scale), offset), inverseDirection);
+		__m128 t1 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(loadPlanes(node.upper[axis]), scale), offset), inverseDirection);
+		entry = _mm_max_ps(_mm_min_ps(t0, t1), entry);
+		exit = _mm_min_ps(_mm_max_ps(t0, t1), exit);
+	}
+	__m128i counts = _mm_loadu_si128((const __m128i*)node.counts);
+	__m128 empty = _mm_castsi128_ps(_mm_cmpeq_epi32(counts, _mm_set1_epi32(-1)));
+	_mm_storeu_ps(distances, entry);
+	return _mm_movemask_ps(_mm_andnot_ps(empty, _mm_cmple_ps(entry, exit)));
+}
+#else
+int WideBVH::intersectChildren(const WideBVHNode& node, const Ray& ray, float maxDistance, float* distances) const {
+	int mask = 0;
+	for (int i = 0; i < WIDE_BVH_WIDTH; i++) {
+		if (node.counts[i] == -1) continue;
+		float entry = 0;
+		float exit = maxDistance;
+		for (int axis = 0; axis < 3; axis++) {
+			float offset = node.origin[axis] - ray.origin[axis];
+			float t0 = ((node.lower[axis][i] * node.scale[axis]) + offset) * ray.inverseDirection[axis];
+			float t1 = ((node.upper[axis][i] * node.scale[axis]) + offset) * ray.inverseDirection[axis];
+			entry = std::max(entry, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+		}
+		distances[i] = entry;
+		if (entry <= exit) mask |= 1 << i;
+	}
+	return mask;
+}
+#endif
+
+bool WideBVH::getClosestHit(const Ray& ray, const TriangleStore& triangles, int indexBlacklist, TriangleHit& hit, int* triangleTests) const {
+	bool found = false;
+	if (nodes.empty()) return found;
+
+	// Leaves go on the stack alongside nodes, each with the count it would have in a WideBVHNode.
+	int stack[WIDE_BVH_STACK_SIZE];
+	int stackCounts[WIDE_BVH_STACK_SIZE];
+	float stackDistances[WIDE_BVH_STACK_SIZE];
+	stack[0] = 0;
+	stackCounts[0] = 0;
+	stackDistances[0] = 0;
+	int stackSize = 1;
+	while (stackSize > 0) {
+		stackSize--;
+		if (stackDistances[stackSize] >= hit.t) continue;
+		int child = stack[stackSize];
+		int count = stackCounts[stackSize];
+		if (count > 0) {
+			if (triangleTests != nullptr) *triangleTests += count;
+			found |= triangles.intersect(ray, child, count, indexBlacklist, hit);
+			continue;
+		}
+
+		const WideBVHNode& node = nodes[child];
+		float distances[WIDE_BVH_WIDTH];
+		int mask = intersectChildren(node, ray, hit.t, distances);
+		// Push the children furthest first so the nearest is popped next.
+		int order[WIDE_BVH_WIDTH];
+		int hits = 0;
+		for (int i = 0; i < WIDE_BVH_WIDTH; i++) {
+			if ((mask & (1 << i)) == 0) continue;
+			int j = hits;
+			while ((j > 0) && (distances[order[j - 1]] < distances[i])) {
+				order[j] = order[j - 1];
+				j--;
+			}
+			order[j] = i;
+			hits++;
+		}
+		for (int i = 0; i < hits; i++) {
+			stack[stackSize] = node.children[order[i]];
+			stackCounts[stackSize] = node.counts[order[i]];
+			stackDistances[stackSize] = distances[order[i]];
+			stackSize++;
+		}
+	}
+
+	return found;
+}
+
+bool WideBVH::isOccluded(const Ray& ray, const TriangleStore& triangles, int indexBlacklist, float maxDistance, int* triangleTests) const {
+	if (nodes.empty()) return false;
+
+	int stack[WIDE_BVH_STACK_SIZE];
+	int stackSize = 1;
+	stack[0] = 0;
+	while (stackSize > 0) {
+		stackSize--;
+		const WideBVHNode& node = nodes[stack[stackSize]];
+		float distances[WIDE_BVH_WIDTH];
+		int mask = intersectChildren(node, ray, maxDistance, distances);
+		for (int i = 0; i < WIDE_BVH_WIDTH; i++) {
+			if ((mask & (1 << i)) == 0) continue;
+			if (node.counts[i] == 0) {
+				stack[stackSize] = node.children[i];
+				stackSize++;
+				continue;
+			}
+			if (triangleTests != nullptr) *triangleTests += node.counts[i];
+			if (triangles.occluded(ray, node.children[i], node.counts[i], indexBlacklist, maxDistance)) return true;
+		}
+	}
+
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <Intersection.h>
+#include <TriangleStore.h>
+
+// How many children each wide node has, 4 or 8. All of a node's children are tested at once,
+// with AVX2 for 8 and SSE for 4, so by default the width follows the instruction set.
+#ifndef WIDE_BVH_WIDTH
+#if defined(__AVX2__)
+#define WIDE_BVH_WIDTH 8
+#else
+#define WIDE_BVH_WIDTH 4
+#endif
+#endif
+// How many bits each quantized child plane takes, 8 or 16.
+#ifndef WIDE_BVH_BITS
+#define WIDE_BVH_BITS 8
+#endif
+// Each level of the tree leaves at most WIDTH - 1 children on the stack, and it is never deeper than the binary one.
+#define WIDE_BVH_STACK_SIZE (64 * WIDE_BVH_WIDTH)
+
+#if WIDE_BVH_BITS == 16
+typedef uint16_t QuantizedPlane;
+#define QUANTIZED_PLANE_MAX 65535
+#else
+typedef uint8_t QuantizedPlane;
+#define QUANTIZED_PLANE_MAX 255
+#endif
+
+class BVH;
+
+// The child boxes are stored as integer steps of scale from origin, rounded outwards so they
+// always contain the real box. A child with a count above 0 is a leaf covering that many slots
+// from children[i], 0 means children[i] is another wide node and -1 means the lane is empty.
+struct WideBVHNode {
+	glm::vec3 origin;
+	glm::vec3 scale;
+	QuantizedPlane lower[3][WIDE_BVH_WIDTH];
+	QuantizedPlane upper[3][WIDE_BVH_WIDTH];
+	int children[WIDE_BVH_WIDTH];
+	int counts[WIDE_BVH_WIDTH];
+};
+
+// A binary BVH collapsed so each node holds up to WIDE_BVH_WIDTH children with quantized bounds.
+// A ray tests all of a node's children in one go and far fewer bytes are read per level. The
+// leaves are the binary tree's, so it traces the same TriangleStore.
+class WideBVH {
+public:
+	std::vector<WideBVHNode> nodes;
+
+	WideBVH();
+	WideBVH(const BVH& bvh);
+	bool isEmpty() const;
+	// The same as BVH::getClosestHit and BVH::isOccluded.
+	bool getClosestHit(const Ray& ray, const TriangleStore& triangles, int indexBlacklist, TriangleHit& hit, int* triangleTests = nullptr) const;
+	bool isOccluded(const Ray& ray, const TriangleStore& triangles, int indexBlacklist, float maxDistance, int* triangleTests = nullptr) const;
+
+private:
+	int collapse(const BVH& bvh, int binaryIndex);
+	// Fills distances with where the ray enters each child, returns a bit for each child it hits before maxDistance.
+	int intersectChildren(const WideBVHNode& node, const Ray& ray, float maxDistance, float* distances) const;
+};
\ No newline at end of file